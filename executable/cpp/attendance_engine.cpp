@@ -0,0 +1,791 @@
+#include "columnar.h"
+#include "token_index.h"
+#include "hnsw.h"
+#include "versioned.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <csignal>
+#include <pthread.h>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Long-lived attendance engine.
+// Keeps the columnar attendance store, the name Trie and the face matcher resident
+// and answers requests over a Unix domain socket, so Flask no longer pays for
+// a process spawn plus a full deserialization on every query.
+//
+// Protocol: one request per line, fields separated by single spaces.
+//   PING
+//   INSERT <student_id> <name>
+//   UPDATE <subject> <attendance> <student_id>
+//   SEARCH <prefix>
+//   SEARCHPAGE <limit> <cursor|-> <prefix>   first result line is the next cursor or "-"
+//   SEARCHTOKENS <prefix> ...        IDs with a name part starting with each prefix, ascending
+//   FUZZY <limit> <max_distance|-> <query>   "<student_id> <distance>" lines, closest first
+//   THRESHOLD <subject> <threshold> <direction>
+//   RANGE <subject> <lo> <hi>
+//   WHERE <column><op><value> ...    IDs matching every condition, e.g. WHERE maths<60 physics<60
+//   UPDATEBATCH <subject> <attendance>:<student_id> ...   one "updated"/"inserted" line each
+//   MATCH <embedding>                best student ID for a face, or -1
+//   MATCHBATCH <embeddings>          one "<student_id> <distance>" line per face
+//   ENROLL <student_id> <embedding>
+//   SAVE
+//   RELOAD
+//   METRICS                          Prometheus text lines (needs ATTENDANCE_METRICS or --metrics)
+// Embeddings are FACE_EMBEDDING_DIM little-endian float32 values, base64-encoded;
+// MATCHBATCH takes several embeddings concatenated before encoding and scores
+// them in parallel (ATTENDANCE_MATCH_THREADS, default one per core).
+// Faces are matched exactly from students.csv unless <serialized_dir>/faces.hnsw
+// exists (see hnsw_index); then MATCH searches that index and ENROLL extends it.
+// Every response starts with "OK <n>" followed by n result lines,
+// or a single "ERR <message>" line. total_attendance follows the subject
+// updates (see columnar.h) and cannot be updated directly. UPDATE and
+// UPDATEBATCH take attendance from 0 to 100, like update_avl. Updates are
+// appended to the subject's and the total's update logs before they are
+// applied (UPDATEBATCH appends all of its records with a single write and
+// sync per log), so an ERR reply leaves nothing applied and nothing a
+// reader saw is lost on restart; SAVE folds the logs into new snapshots.
+//
+// Each client is served on its own thread. Attendance has a single writer and
+// any number of readers: THRESHOLD, RANGE and WHERE run against a published
+// version of the columnar store (see versioned.h) and never wait for an
+// update, while UPDATE/UPDATEBATCH are logged, applied and compacted one at a
+// time under the writer mutex, so the update logs record them in the order
+// readers observed them. The name Trie and the faces use reader/writer locks.
+// Snapshot files are rewritten under their writer lock (see flat_format.h),
+// so the command-line tools can update them while the engine is running; the
+// engine applies their updates when it next compacts that file (or on RELOAD).
+
+// Commands counted in attendance_requests_total, in METRICS output order.
+static const char* const COMMANDS[] = {"PING", "INSERT", "UPDATE", "UPDATEBATCH", "SEARCH", "SEARCHPAGE",
+                                       "SEARCHTOKENS", "FUZZY", "THRESHOLD", "RANGE", "WHERE", "MATCH",
+                                       "MATCHBATCH", "ENROLL", "SAVE", "RELOAD", "METRICS"};
+static constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void handleStop(int) {
+    stopRequested = 1;
+}
+
+class AttendanceEngine {
+private:
+    string serializedDir;
+    Versioned<ColumnarStore> attendance;
+    mutex attendanceWriter;     // held for each update, its logging and compaction
+    vector<uint32_t> snapshotGenerations;  // per column, of the snapshot the engine last read or wrote
+    shared_mutex trieLock;      // guards trie, tokens and trieDirty
+    shared_mutex facesLock;     // guards matcher, faceIndex and the match settings
+    Trie trie;
+    Trie tokens;                // name parts (token_index.h), kept in step with trie
+    bool trieDirty;
+    string studentsFile;
+    FaceMatcher matcher;
+    HNSWIndex faceIndex;
+    bool useFaceIndex;
+    bool faceIndexDirty;
+    float matchThreshold;
+    size_t matchEf;
+
+    struct RequestStats {
+        atomic<uint64_t> calls{0};
+        atomic<uint64_t> nanos{0};
+    };
+    RequestStats requestStats[COMMAND_COUNT];
+
+    string subjectFile(size_t column) const {
+        return attendance.read()->snapshotFile(serializedDir, column);
+    }
+
+    string nameFile() const {
+        return serializedDir + "/name.dat";
+    }
+
+    string faceIndexFile() const {
+        return serializedDir + "/faces.hnsw";
+    }
+
+    static string ok(const vector<string>& lines) {
+        string response = "OK " + to_string(lines.size()) + "\n";
+        for (const auto& line : lines) {
+            response += line;
+            response += '\n';
+        }
+        return response;
+    }
+
+    // One student ID per line
+    static string okIds(const vector<int>& ids) {
+        string response = "OK " + to_string(ids.size()) + "\n";
+        for (int id : ids) {
+            response += to_string(id);
+            response += '\n';
+        }
+        return response;
+    }
+
+    static string err(const string& message) {
+        return "ERR " + message + "\n";
+    }
+
+    // Decodes base64 into one or more embeddings of FACE_EMBEDDING_DIM floats each.
+    static bool decodeEmbeddings(const string& text, vector<float>& embeddings) {
+        string bytes;
+        uint32_t bits = 0;
+        int bitCount = 0;
+        for (char c : text) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+') value = 62;
+            else if (c == '/') value = 63;
+            else if (c == '=') break;
+            else return false;
+            bits = (bits << 6) | value;
+            bitCount += 6;
+            if (bitCount >= 8) {
+                bitCount -= 8;
+                bytes += static_cast<char>((bits >> bitCount) & 0xFF);
+            }
+        }
+        const size_t embeddingBytes = FACE_EMBEDDING_DIM * sizeof(float);
+        if (bytes.empty() || bytes.size() % embeddingBytes != 0) return false;
+        embeddings.resize(bytes.size() / sizeof(float));
+        memcpy(embeddings.data(), bytes.data(), bytes.size());
+        return true;
+    }
+
+    static bool decodeEmbedding(const string& text, vector<float>& embedding) {
+        return decodeEmbeddings(text, embedding) && embedding.size() == FACE_EMBEDDING_DIM;
+    }
+
+    static bool parseInt(const string& text, int& value) {
+        try {
+            size_t used = 0;
+            value = stoi(text, &used);
+            return used == text.size();
+        } catch (const exception&) {
+            return false;
+        }
+    }
+
+public:
+    AttendanceEngine(const string& dir, const string& students)
+        : serializedDir(dir), trieDirty(false), studentsFile(students),
+          matcher(FaceMatcher::configuredMetric()), useFaceIndex(false), faceIndexDirty(false),
+          matchThreshold(FaceMatcher::configuredThreshold(matcher.getMetric())),
+          matchEf(HNSWIndex::configuredEf()) {}
+
+    // Loads (or reloads) every index from disk, discarding unsaved changes.
+    void load() {
+        ColumnarStore store;
+        vector<string> missing;
+        store.load(serializedDir, &missing);
+        for (const auto& filename : missing) {
+            cerr << "Warning: " << filename << " not found. Starting with an empty tree." << endl;
+        }
+        {
+            lock_guard<mutex> writer(attendanceWriter);
+            attendance.reset(store);
+            snapshotGenerations.assign(store.columnCount(), 0);
+            for (size_t c = 0; c < store.columnCount(); ++c) snapshotGenerations[c] = store.index(c).generation();
+        }
+
+        unique_lock<shared_mutex> names(trieLock);
+        trie = Trie();
+        if (!trie.deserialize(nameFile())) {
+            cerr << "Warning: " << nameFile() << " not found. Starting with a new Trie." << endl;
+            trie = Trie();
+        }
+        tokens = Trie();
+        if (!tokens.deserialize(tokenIndexFile(nameFile()))) tokens = buildTokenIndex(trie);
+        trieDirty = false;
+        names.unlock();
+
+        unique_lock<shared_mutex> faces(facesLock);
+        matcher = FaceMatcher(matcher.getMetric());
+        useFaceIndex = faceIndex.load(faceIndexFile());
+        faceIndexDirty = false;
+        if (useFaceIndex) {
+            matchThreshold = FaceMatcher::configuredThreshold(faceIndex.getMetric());
+        } else {
+            faceIndex = HNSWIndex();
+            matchThreshold = FaceMatcher::configuredThreshold(matcher.getMetric());
+            if (!matcher.load(studentsFile)) {
+                cerr << "Warning: " << studentsFile << " not found. No faces enrolled." << endl;
+            }
+        }
+    }
+
+    // Applies the updates a command-line tool made to a subject's file since
+    // the engine last wrote its snapshot: the records in its update log or,
+    // once the tool has compacted it, the whole snapshot. The file then holds
+    // every update the engine logged as well, so where the two disagree the
+    // file is newer. The totals this moves are appended to the total's log
+    // before the store changes. Caller holds attendanceWriter and the
+    // subject's writer lock.
+    bool absorbFileUpdates(size_t column) {
+        const size_t totalColumn = attendance.read()->totalColumn();
+        if (column == totalColumn) return true;  // derived from the subjects
+        const string datFilename = subjectFile(column);
+        const uint32_t generation = AVLView::readGeneration(datFilename);
+        unordered_map<int, int> onDisk;  // studentId -> attendance
+        if (generation == snapshotGenerations[column]) {
+            for (const UpdateRecord& record : UpdateLog::read(datFilename, generation)) {
+                onDisk[record.studentId] = record.attendance;
+            }
+        } else {
+            AVLTree snapshot;
+            if (!snapshot.deserialize(datFilename)) return false;
+            snapshot.forEach([&](int value, int studentId) { onDisk[studentId] = value; });
+        }
+
+        vector<UpdateRecord> changed;
+        for (const auto& [studentId, value] : onDisk) {
+            if (attendance.writerCopy().value(column, studentId) != value) {
+                changed.push_back(UpdateLog::makeRecord(studentId, value));
+            }
+        }
+        if (changed.empty()) return true;
+        const string totalFilename = subjectFile(totalColumn);
+        {
+            WriterLock totalLock(totalFilename);
+            if (!totalLock.held() ||
+                !UpdateLog::append(totalFilename, plannedTotals(column, changed), AVLView::readGeneration(totalFilename))) {
+                return false;
+            }
+        }
+        attendance.write([column, changed](ColumnarStore& store) {
+            for (const UpdateRecord& record : changed) store.set(column, record.studentId, record.attendance);
+        });
+        return true;
+    }
+
+    // Folds a column's update log into a new snapshot, after absorbing what
+    // the tools wrote to the file meanwhile. Caller holds attendanceWriter.
+    bool compact(size_t column) {
+        const string datFilename = subjectFile(column);
+        WriterLock lock(datFilename);
+        if (lock.held() && absorbFileUpdates(column) &&
+            attendance.writerCopy().index(column).serialize(datFilename)) {
+            snapshotGenerations[column] = AVLView::readGeneration(datFilename);
+            return true;
+        }
+        cerr << "Failed to serialize " << datFilename << endl;
+        return false;
+    }
+
+    // The total_attendance records a run of subject updates will leave,
+    // worked out on the writer copy before any of them is applied so they
+    // can be logged first. Repeated students build on their earlier update.
+    vector<UpdateRecord> plannedTotals(size_t column, const vector<UpdateRecord>& records) {
+        const ColumnarStore& store = attendance.writerCopy();
+        unordered_map<int, pair<int, int>> pending;  // studentId -> (subject, total) so far
+        vector<UpdateRecord> totals;
+        totals.reserve(records.size());
+        for (const UpdateRecord& record : records) {
+            auto found = pending.find(record.studentId);
+            if (found == pending.end()) {
+                found = pending.emplace(record.studentId, make_pair(store.value(column, record.studentId),
+                                                                    store.value(store.totalColumn(), record.studentId))).first;
+            }
+            auto& [subject, total] = found->second;
+            total = ColumnarStore::movedTotal(total, subject, record.attendance);
+            subject = record.attendance;
+            totals.push_back(UpdateLog::makeRecord(record.studentId, total));
+        }
+        return totals;
+    }
+
+    // Makes subject updates durable before anything is applied: one log
+    // append for the subject and one for the totals they move, under both
+    // writer locks. If the total's append fails, the subject's is truncated
+    // away again, so the two logs never disagree. Caller holds
+    // attendanceWriter. The generations are read from the snapshots under
+    // their writer locks, so appends follow a compaction made by a tool.
+    string logUpdates(size_t column, const vector<UpdateRecord>& subjectRecords,
+                      const vector<UpdateRecord>& totalRecords) {
+        const ColumnarStore& store = attendance.writerCopy();
+        const string subjectFilename = subjectFile(column), totalFilename = subjectFile(store.totalColumn());
+        WriterLock subjectLock(subjectFilename);
+        WriterLock totalLock(totalFilename);  // always after the subject's (see absorbFileUpdates)
+        size_t firstRecord = 0;
+        if (!subjectLock.held() ||
+            !UpdateLog::append(subjectFilename, subjectRecords, AVLView::readGeneration(subjectFilename), &firstRecord)) {
+            return "failed to append to the update log for " + store.name(column);
+        }
+        if (!totalLock.held() ||
+            !UpdateLog::append(totalFilename, totalRecords, AVLView::readGeneration(totalFilename))) {
+            if (!UpdateLog::truncate(subjectFilename, firstRecord)) {
+                cerr << "Failed to roll back " << UpdateLog::pathFor(subjectFilename) << endl;
+            }
+            return "failed to append to the update log for " + store.name(store.totalColumn());
+        }
+        return "";
+    }
+
+    // Logs subject updates, then applies and publishes them; found[i] tells
+    // whether the i-th student already had a value. A log that has grown
+    // long enough is compacted afterwards; if that fails the updates are
+    // still durable in it, and the next update or SAVE retries. Caller holds
+    // attendanceWriter.
+    string applyUpdates(size_t column, const vector<UpdateRecord>& records, vector<bool>& found) {
+        string failure = logUpdates(column, records, plannedTotals(column, records));
+        if (!failure.empty()) return failure;
+        found = attendance.write([column, records](ColumnarStore& store) {
+            vector<bool> existed;
+            for (const auto& record : records) existed.push_back(store.set(column, record.studentId, record.attendance));
+            return existed;
+        });
+        for (size_t target : {column, attendance.read()->totalColumn()}) {
+            if (UpdateLog::recordCount(subjectFile(target)) >= UpdateLog::compactionThreshold()) compact(target);
+        }
+        return "";
+    }
+
+    // Compacts every pending update log and writes the trie and face index if they changed.
+    bool save() {
+        bool success = true;
+        {
+            lock_guard<mutex> writer(attendanceWriter);
+            for (size_t column = 0; column < attendance.read()->columnCount(); ++column) {
+                if (UpdateLog::recordCount(subjectFile(column)) == 0) continue;
+                if (!compact(column)) success = false;
+            }
+        }
+        unique_lock<shared_mutex> faces(facesLock);
+        if (faceIndexDirty) {
+            if (faceIndex.save(faceIndexFile())) {
+                faceIndexDirty = false;
+            } else {
+                cerr << "Failed to write " << faceIndexFile() << endl;
+                success = false;
+            }
+        }
+        faces.unlock();
+        unique_lock<shared_mutex> names(trieLock);
+        if (trieDirty) {
+            if (trie.serialize(nameFile()) && tokens.serialize(tokenIndexFile(nameFile()))) {
+                trieDirty = false;
+            } else {
+                cerr << "Failed to serialize " << nameFile() << " or its token index" << endl;
+                success = false;
+            }
+        }
+        return success;
+    }
+
+    // Answers one request, timing it per command while metrics are on.
+    string handle(const string& request) {
+        if (!Metrics::on()) return dispatch(request);
+        const string command = request.substr(0, request.find(' '));
+        auto started = chrono::steady_clock::now();
+        string response = dispatch(request);
+        for (size_t c = 0; c < COMMAND_COUNT; ++c) {
+            if (command != COMMANDS[c]) continue;
+            auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started);
+            requestStats[c].calls.fetch_add(1, memory_order_relaxed);
+            requestStats[c].nanos.fetch_add(static_cast<uint64_t>(elapsed.count()), memory_order_relaxed);
+        }
+        return response;
+    }
+
+    // The hot-path counters (see metrics.h) plus per-command request totals.
+    vector<string> metricsLines() {
+        vector<string> lines = Metrics::instance().prometheus();
+        lines.push_back("# TYPE attendance_requests_total counter");
+        for (size_t c = 0; c < COMMAND_COUNT; ++c) {
+            lines.push_back(string("attendance_requests_total{command=\"") + COMMANDS[c] + "\"} " +
+                            to_string(requestStats[c].calls.load(memory_order_relaxed)));
+        }
+        lines.push_back("# TYPE attendance_request_seconds_total counter");
+        char seconds[64];
+        for (size_t c = 0; c < COMMAND_COUNT; ++c) {
+            snprintf(seconds, sizeof(seconds), "%.9f", requestStats[c].nanos.load(memory_order_relaxed) / 1e9);
+            lines.push_back(string("attendance_request_seconds_total{command=\"") + COMMANDS[c] + "\"} " + seconds);
+        }
+        lines.push_back("# TYPE attendance_students gauge");
+        lines.push_back("attendance_students " + to_string(attendance.read()->studentCount()));
+        return lines;
+    }
+
+private:
+    string dispatch(const string& request) {
+        size_t space = request.find(' ');
+        string command = request.substr(0, space);
+        string rest = space == string::npos ? "" : request.substr(space + 1);
+
+        if (command == "PING") return ok({});
+
+        if (command == "INSERT") {
+            size_t split = rest.find(' ');
+            int studentId;
+            if (split == string::npos || !parseInt(rest.substr(0, split), studentId)) {
+                return err("usage: INSERT <student_id> <name>");
+            }
+            unique_lock<shared_mutex> names(trieLock);
+            trie.insert(rest.substr(split + 1), studentId);
+            insertNameTokens(tokens, rest.substr(split + 1), studentId);
+            trieDirty = true;
+            return ok({});
+        }
+
+        if (command == "SEARCH") {
+            if (rest.empty()) return err("usage: SEARCH <prefix>");
+            shared_lock<shared_mutex> names(trieLock);
+            return okIds(trie.search(rest));
+        }
+
+        if (command == "SEARCHPAGE") {
+            istringstream args(rest);
+            string limitField, cursor;
+            int limit;
+            if (!(args >> limitField >> cursor) || !parseInt(limitField, limit) || limit <= 0 || args.get() != ' ') {
+                return err("usage: SEARCHPAGE <limit> <cursor|-> <prefix>");
+            }
+            string prefix((istreambuf_iterator<char>(args)), istreambuf_iterator<char>());
+            if (prefix.empty()) return err("usage: SEARCHPAGE <limit> <cursor|-> <prefix>");
+            SearchCursor position;
+            if (cursor == "-") {
+                cursor.clear();
+            } else if (!SearchCursor::decode(cursor, position)) {
+                return err("malformed cursor: " + cursor);
+            }
+            string nextCursor;
+            shared_lock<shared_mutex> names(trieLock);
+            vector<int> ids = trie.search(prefix, limit, cursor, &nextCursor);
+            names.unlock();
+            vector<string> lines = {nextCursor.empty() ? "-" : nextCursor};
+            for (int id : ids) lines.push_back(to_string(id));
+            return ok(lines);
+        }
+
+        if (command == "SEARCHTOKENS") {
+            if (nameTokens(rest).empty()) return err("usage: SEARCHTOKENS <prefix> ...");
+            shared_lock<shared_mutex> names(trieLock);
+            vector<int> ids = searchTokens(tokens, rest);
+            names.unlock();
+            return okIds(ids);
+        }
+
+        if (command == "FUZZY") {
+            istringstream args(rest);
+            string limitField, distanceField;
+            int limit, maxDistance = -1;
+            if (!(args >> limitField >> distanceField) || !parseInt(limitField, limit) || limit <= 0 ||
+                (distanceField != "-" && (!parseInt(distanceField, maxDistance) || maxDistance < 0 ||
+                                          maxDistance > MAX_FUZZY_DISTANCE)) ||
+                args.get() != ' ') {
+                return err("usage: FUZZY <limit> <max_distance|-> <query>");
+            }
+            string query((istreambuf_iterator<char>(args)), istreambuf_iterator<char>());
+            if (query.empty()) return err("usage: FUZZY <limit> <max_distance|-> <query>");
+            if (maxDistance < 0) maxDistance = defaultFuzzyDistance(foldName(query).size());
+            shared_lock<shared_mutex> names(trieLock);
+            vector<FuzzyMatch> matches = trie.fuzzySearch(query, maxDistance, limit);
+            names.unlock();
+            vector<string> lines;
+            for (const auto& match : matches) lines.push_back(to_string(match.studentId) + " " + to_string(match.distance));
+            return ok(lines);
+        }
+
+        if (command == "MATCH") {
+            vector<float> embedding;
+            if (!decodeEmbedding(rest, embedding)) return err("usage: MATCH <base64 embedding>");
+            shared_lock<shared_mutex> faces(facesLock);
+            int studentId = useFaceIndex ? faceIndex.match(embedding.data(), matchThreshold, matchEf)
+                                         : matcher.match(embedding.data(), matchThreshold);
+            return ok({to_string(studentId)});
+        }
+
+        if (command == "MATCHBATCH") {
+            vector<float> embeddings;
+            if (!decodeEmbeddings(rest, embeddings)) return err("usage: MATCHBATCH <base64 embeddings>");
+            const size_t count = embeddings.size() / FACE_EMBEDDING_DIM;
+            shared_lock<shared_mutex> faces(facesLock);
+            vector<FaceMatch> matches = useFaceIndex
+                ? faceIndex.matchBatch(embeddings.data(), count, matchThreshold, matchEf)
+                : matcher.matchBatch(embeddings.data(), count, matchThreshold);
+            vector<string> lines;
+            lines.reserve(count);
+            for (const auto& match : matches) {
+                lines.push_back(to_string(match.studentId) + " " + to_string(match.distance));
+            }
+            return ok(lines);
+        }
+
+        if (command == "ENROLL") {
+            size_t split = rest.find(' ');
+            int studentId;
+            vector<float> embedding;
+            if (split == string::npos || !parseInt(rest.substr(0, split), studentId) ||
+                !decodeEmbedding(rest.substr(split + 1), embedding)) {
+                return err("usage: ENROLL <student_id> <base64 embedding>");
+            }
+            unique_lock<shared_mutex> faces(facesLock);
+            bool added = useFaceIndex ? faceIndex.insert(studentId, embedding.data())
+                                      : matcher.add(studentId, embedding.data());
+            if (!added) return err("embedding rejected for the current metric");
+            faceIndexDirty = faceIndexDirty || useFaceIndex;
+            return ok({});
+        }
+
+        if (command == "SAVE") {
+            if (!save()) return err("failed to save one or more indexes");
+            return ok({});
+        }
+
+        if (command == "RELOAD") {
+            load();
+            return ok({});
+        }
+
+        if (command == "METRICS") {
+            if (!Metrics::on()) return err("metrics are off; start the engine with ATTENDANCE_METRICS=1 or --metrics");
+            return ok(metricsLines());
+        }
+
+        if (command == "WHERE") {
+            istringstream args(rest);
+            string condition;
+            vector<ColumnRange> ranges;
+            auto snapshot = attendance.read();
+            while (args >> condition) {
+                ColumnRange range;
+                if (!snapshot->parseCondition(condition, range)) return err("malformed condition: " + condition);
+                ranges.push_back(range);
+            }
+            if (ranges.empty()) return err("usage: WHERE <column><op><value> ...");
+            vector<string> lines;
+            for (int id : snapshot->select(ranges)) {
+                lines.push_back(to_string(id));
+            }
+            return ok(lines);
+        }
+
+        if (command == "UPDATEBATCH") {
+            istringstream args(rest);
+            string subject, pair;
+            if (!(args >> subject)) return err("usage: UPDATEBATCH <subject> <attendance>:<student_id> ...");
+            auto snapshot = attendance.read();
+            int column = snapshot->columnOf(subject);
+            if (column < 0) return err("unknown subject: " + subject);
+            if (static_cast<size_t>(column) == snapshot->totalColumn()) return err("total_attendance is derived from the subjects");
+            vector<UpdateRecord> records;
+            while (args >> pair) {
+                size_t colon = pair.find(':');
+                int newAttendance, studentId;
+                if (colon == string::npos || !parseInt(pair.substr(0, colon), newAttendance) ||
+                    !parseInt(pair.substr(colon + 1), studentId)) {
+                    return err("malformed update: " + pair);
+                }
+                if (!isValidAttendance(newAttendance)) return err("attendance must be between 0 and 100");
+                records.push_back(UpdateLog::makeRecord(studentId, newAttendance));
+            }
+            if (records.empty()) return err("usage: UPDATEBATCH <subject> <attendance>:<student_id> ...");
+            // Validated up front so a malformed pair leaves the store untouched.
+            snapshot.reset();
+            lock_guard<mutex> writer(attendanceWriter);
+            vector<bool> found;
+            string failure = applyUpdates(column, records, found);
+            if (!failure.empty()) return err(failure);
+            vector<string> lines;
+            lines.reserve(found.size());
+            for (bool existed : found) lines.push_back(existed ? "updated" : "inserted");
+            return ok(lines);
+        }
+
+        // The remaining commands all address a subject column.
+        istringstream args(rest);
+        string subject;
+        int first, second;
+        if (!(args >> subject >> first >> second)) return err("malformed request: " + request);
+        auto snapshot = attendance.read();
+        int column = snapshot->columnOf(subject);
+        if (column < 0) return err("unknown subject: " + subject);
+        const AVLTree& tree = snapshot->index(column);
+
+        if (command == "UPDATE") {
+            int newAttendance = first, studentId = second;
+            if (!isValidAttendance(newAttendance)) return err("attendance must be between 0 and 100");
+            if (static_cast<size_t>(column) == snapshot->totalColumn()) return err("total_attendance is derived from the subjects");
+            // Let go of the version we read so the writer can reuse it.
+            snapshot.reset();
+            lock_guard<mutex> writer(attendanceWriter);
+            // Durable through the update logs before readers see it; the
+            // snapshots are rewritten only when a log crosses its threshold.
+            vector<bool> found;
+            string failure = applyUpdates(column, {UpdateLog::makeRecord(studentId, newAttendance)}, found);
+            if (!failure.empty()) return err(failure);
+            return ok({found[0] ? "updated" : "inserted"});
+        }
+
+        if (command == "THRESHOLD") {
+            int threshold = first, direction = second;
+            if (direction != 1 && direction != -1) return err("direction must be 1 (above) or -1 (below)");
+            vector<string> lines;
+            for (int id : tree.getStudentIdsByThreshold(threshold, direction)) {
+                lines.push_back(to_string(id));
+            }
+            return ok(lines);
+        }
+
+        if (command == "RANGE") {
+            int lo = first, hi = second;
+            if (lo > hi) return err("range lower bound must not exceed upper bound");
+            vector<string> lines;
+            for (int id : tree.getStudentIdsInRange(lo, hi)) {
+                lines.push_back(to_string(id));
+            }
+            return ok(lines);
+        }
+
+        return err("unknown command: " + command);
+    }
+};
+
+// Connections being served, so that shutdown can close them and wait.
+static mutex clientsMutex;
+static condition_variable clientsDone;
+static set<int> activeClients;
+
+// Serves one client until it disconnects; requests are answered in order.
+static void serveClient(int clientFd, AttendanceEngine& engine) {
+    string buffer;
+    char chunk[4096];
+    while (!stopRequested) {
+        ssize_t received = recv(clientFd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) continue;
+            return;
+        }
+        buffer.append(chunk, received);
+
+        size_t newline;
+        while ((newline = buffer.find('\n')) != string::npos) {
+            string request = buffer.substr(0, newline);
+            buffer.erase(0, newline + 1);
+            if (!request.empty() && request.back() == '\r') request.pop_back();
+
+            string response = engine.handle(request);
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t n = send(clientFd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                sent += n;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    MetricsReport metrics("attendance_engine", argc, argv);
+    if (argc > 4) {
+        cerr << "Usage: " << argv[0] << " [--metrics] [socket_path] [serialized_dir] [students_csv]" << endl;
+        return 1;
+    }
+
+    const string socketPath = argc >= 2 ? argv[1] : "/tmp/attendance_engine.sock";
+    // Same relative layout as the other tools: run from executable/cpp.
+    const string serializedDir = argc >= 3 ? argv[2] : "../serialized";
+    const string studentsFile = argc >= 4 ? argv[3] : "../data/students.csv";
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path is too long: " << socketPath << endl;
+        return 1;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    AttendanceEngine engine(serializedDir, studentsFile);
+    engine.load();
+
+    int serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (serverFd < 0) {
+        cerr << "Failed to create socket: " << strerror(errno) << endl;
+        return 1;
+    }
+    unlink(socketPath.c_str());
+    if (bind(serverFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(serverFd, 16) < 0) {
+        cerr << "Failed to listen on " << socketPath << ": " << strerror(errno) << endl;
+        close(serverFd);
+        return 1;
+    }
+
+    // No SA_RESTART, so a signal interrupts accept()/recv() and we can flush.
+    struct sigaction action{};
+    action.sa_handler = handleStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    cout << "Attendance engine listening on " << socketPath << endl;
+
+    // Client threads start with the stop signals blocked, so a signal always
+    // lands on this thread and interrupts accept().
+    sigset_t stopSignals, previousMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+
+    while (!stopRequested) {
+        int clientFd = accept(serverFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            if (errno == EINTR) continue;
+            cerr << "accept failed: " << strerror(errno) << endl;
+            break;
+        }
+        {
+            lock_guard<mutex> lock(clientsMutex);
+            activeClients.insert(clientFd);
+        }
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask);
+        thread([clientFd, &engine] {
+            serveClient(clientFd, engine);
+            {
+                lock_guard<mutex> lock(clientsMutex);
+                activeClients.erase(clientFd);
+                clientsDone.notify_all();
+            }
+            close(clientFd);
+        }).detach();
+        pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+    }
+
+    close(serverFd);
+    unlink(socketPath.c_str());
+
+    // Wake every client still connected and let its in-flight request finish.
+    {
+        unique_lock<mutex> lock(clientsMutex);
+        for (int clientFd : activeClients) shutdown(clientFd, SHUT_RDWR);
+        clientsDone.wait(lock, [] { return activeClients.empty(); });
+    }
+
+    if (!engine.save()) return 1;
+    cout << "Attendance engine stopped; indexes saved." << endl;
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "columnar.h"
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Answers multi-subject attendance queries in one process, e.g.
+//   ./attendance_query "maths<60" "physics<60"
+// Conditions are ANDed; each is <column><op><value> with op < <= > >= =,
+// and column a subject or total_attendance. The store is loaded from the
+// subject snapshots (and their update logs) or straight from a CSV.
+//
+// Aggregates are answered from the per-column AVL subtree sizes in
+// O(log n) and printed as one JSON object on stdout:
+//   count chemistry<75               {"count":20}
+//   rank maths 836004                {"column":"maths","student_id":836004,"attendance":75,
+//                                     "below":27,"above":66,"rank":67,"students":98}
+//   smallest|largest maths 10        k-th lowest/highest student (1-based)
+//   percentile chemistry 10          nearest-rank percentile, 0 < p <= 100
+// rank 1 is the highest attendance. Failures print {"error":"..."} and exit 1.
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--serialized <dir> | --csv <attendance_csv>] <condition> [<condition> ...]" << endl;
+    cerr << "       " << program << " [--serialized <dir> | --csv <attendance_csv>] count <condition> [<condition> ...]" << endl;
+    cerr << "       " << program << " [--serialized <dir> | --csv <attendance_csv>] rank <column> <student_id>" << endl;
+    cerr << "       " << program << " [--serialized <dir> | --csv <attendance_csv>] smallest|largest <column> <k>" << endl;
+    cerr << "       " << program << " [--serialized <dir> | --csv <attendance_csv>] percentile <column> <p>" << endl;
+    cerr << "  condition: <column><op><value>, op one of < <= > >= =, e.g. maths<60" << endl;
+    cerr << "  --serialized: directory of <column>.dat snapshots (default ../serialized)" << endl;
+    cerr << "  --csv: build the store from attendance.csv instead" << endl;
+}
+
+static string jsonString(const string& text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static int fail(const string& message) {
+    cout << "{\"error\":" << jsonString(message) << "}" << endl;
+    return 1;
+}
+
+// Runs one aggregate query; args are the words after the query name.
+static int runAggregate(const ColumnarStore& store, const string& query, const vector<string>& args) {
+    if (query == "count") {
+        vector<ColumnRange> ranges;
+        for (const auto& text : args) {
+            ColumnRange range;
+            if (!store.parseCondition(text, range)) return fail("invalid condition: " + text);
+            ranges.push_back(range);
+        }
+        if (ranges.empty()) return fail("count needs at least one condition");
+        size_t count = ranges.size() == 1
+            ? store.index(ranges[0].column).countInRange(ranges[0].lo, ranges[0].hi)
+            : store.select(ranges).size();
+        cout << "{\"count\":" << count << "}" << endl;
+        return 0;
+    }
+
+    if (args.size() != 2) return fail(query + " takes a column and one number");
+    int column = store.columnOf(args[0]);
+    if (column < 0) return fail("unknown column: " + args[0]);
+    const AVLTree& tree = store.index(column);
+    const string prefix = "{\"column\":" + jsonString(args[0]);
+    double number;
+    try {
+        size_t used;
+        number = stod(args[1], &used);
+        if (used != args[1].size()) throw invalid_argument(args[1]);
+    } catch (const exception&) {
+        return fail("not a number: " + args[1]);
+    }
+
+    if (query == "rank") {
+        int studentId = static_cast<int>(number), attendance;
+        if (studentId != number || !tree.attendanceOf(studentId, attendance)) {
+            return fail("no " + args[0] + " record for student " + args[1]);
+        }
+        size_t below = tree.countAtMost(attendance - 1), above = tree.size() - tree.countAtMost(attendance);
+        cout << prefix << ",\"student_id\":" << studentId << ",\"attendance\":" << attendance
+             << ",\"below\":" << below << ",\"above\":" << above << ",\"rank\":" << above + 1
+             << ",\"students\":" << tree.size() << "}" << endl;
+        return 0;
+    }
+
+    if (query == "smallest" || query == "largest") {
+        if (number < 1 || number != static_cast<size_t>(number) || number > tree.size()) {
+            return fail("k must be between 1 and " + to_string(tree.size()));
+        }
+        size_t k = static_cast<size_t>(number);
+        int attendance, studentId;
+        if (!tree.kthSmallest(query == "smallest" ? k - 1 : tree.size() - k, attendance, studentId)) {
+            return fail("no student at k=" + args[1]);
+        }
+        cout << prefix << ",\"k\":" << k << ",\"attendance\":" << attendance
+             << ",\"student_id\":" << studentId << "}" << endl;
+        return 0;
+    }
+
+    if (query == "percentile") {
+        int attendance;
+        if (!tree.percentile(number, attendance)) return fail("percentile needs 0 < p <= 100 and a non-empty column");
+        cout << prefix << ",\"percentile\":" << args[1] << ",\"attendance\":" << attendance << "}" << endl;
+        return 0;
+    }
+    return fail("unknown query: " + query);
+}
+
+int main(int argc, char* argv[]) {
+    MetricsReport metrics("attendance_query", argc, argv);
+    string serializedDir = "../serialized";
+    string csvFilename;
+    vector<string> conditions;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if ((arg == "--serialized" || arg == "--csv") && i + 1 < argc) {
+            (arg == "--csv" ? csvFilename : serializedDir) = argv[++i];
+        } else {
+            conditions.push_back(arg);
+        }
+    }
+    if (conditions.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    ColumnarStore store;
+    const string query = conditions[0];
+    const bool aggregate = query == "count" || query == "rank" || query == "smallest" ||
+                           query == "largest" || query == "percentile";
+    vector<ColumnRange> ranges;
+    for (const auto& text : aggregate ? vector<string>() : conditions) {
+        ColumnRange range;
+        if (!store.parseCondition(text, range)) {
+            cerr << "Invalid condition: " << text << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        ranges.push_back(range);
+    }
+
+    if (!csvFilename.empty()) {
+        if (!store.loadCSV(csvFilename)) {
+            cerr << "Error opening CSV file: " << csvFilename << endl;
+            return 1;
+        }
+    } else {
+        vector<string> missing;
+        store.load(serializedDir, &missing);
+        if (missing.size() == store.columnCount()) {
+            cerr << "No attendance snapshots found in " << serializedDir << endl;
+            return 1;
+        }
+        for (const auto& filename : missing) {
+            cerr << "Warning: " << filename << " not found" << endl;
+        }
+    }
+
+    if (aggregate) {
+        return runAggregate(store, query, vector<string>(conditions.begin() + 1, conditions.end()));
+    }
+
+    vector<int> studentIds = store.select(ranges);
+    if (studentIds.empty()) {
+        cout << "-1" << endl;
+    } else {
+        for (int id : studentIds) {
+            cout << id << endl;
+        }
+    }
+    return 0;
+}
@@ -1,241 +1,859 @@
 #pragma once
+#include "node_pool.h"
+#include "flat_format.h"
+#include "update_log.h"
+#include "posting_list.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
-#include <memory>
 #include <algorithm>
-#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <tuple>
+#include <cstdio>
+#include <climits>
 #include <cmath>
 
 using namespace std;
 
-// AVL Tree Node structure
+// A subject attendance percentage, as update_avl and the engine accept it.
+inline bool isValidAttendance(int attendance) {
+    return attendance >= 0 && attendance <= 100;
+}
+
+// AVL Tree Node structure (children are indices into the tree's NodePool)
+// subtreeSize counts the students (not nodes) in the subtree, so counts,
+// ranks and k-th queries run in O(log n) without enumerating IDs. A node's
+// students are a compressed sorted list (posting_list.h): with about a
+// hundred attendance values, each node holds a large share of the roster.
 struct AVLNode {
     int attendance;
-    vector<int> studentIds;
+    PostingList studentIds;
     int height;
-    shared_ptr<AVLNode> left;
-    shared_ptr<AVLNode> right;
+    uint32_t subtreeSize;
+    int32_t left;
+    int32_t right;
+
+    AVLNode()
+        : attendance(0), height(1), subtreeSize(0), left(NULL_NODE), right(NULL_NODE) {}
 
-    AVLNode(int attend) 
-        : attendance(attend), height(1), left(nullptr), right(nullptr) {}
+    AVLNode(int attend)
+        : attendance(attend), height(1), subtreeSize(0), left(NULL_NODE), right(NULL_NODE) {}
 
-    AVLNode(int attend, int studentId) 
-        : attendance(attend), height(1), left(nullptr), right(nullptr) {
-        studentIds.push_back(studentId);
+    AVLNode(int attend, int studentId)
+        : attendance(attend), height(1), subtreeSize(1), left(NULL_NODE), right(NULL_NODE) {
+        studentIds.insert(studentId);
     }
 };
 
 class AVLTree {
 private:
-    shared_ptr<AVLNode> root;
-    bool studentFound;
+    NodePool<AVLNode> nodes;
+    int32_t root;
+    // Generation of the snapshot this tree was loaded from / last written as
+    uint32_t logGeneration;
+    // Side index studentId -> attendance, so updates never scan the tree
+    unordered_map<int, int> idIndex;
 
-    int getHeight(const shared_ptr<AVLNode>& node) {
-        if (!node) return 0;
-        return node->height;
+    int getHeight(int32_t node) const {
+        if (node == NULL_NODE) return 0;
+        return nodes[node].height;
     }
 
-    int getBalanceFactor(const shared_ptr<AVLNode>& node) {
-        if (!node) return 0;
-        return getHeight(node->left) - getHeight(node->right);
+    int getBalanceFactor(int32_t node) const {
+        if (node == NULL_NODE) return 0;
+        return getHeight(nodes[node].left) - getHeight(nodes[node].right);
     }
 
-    void updateHeight(shared_ptr<AVLNode>& node) {
-        if (!node) return;
-        node->height = 1 + max(getHeight(node->left), getHeight(node->right));
+    size_t getSize(int32_t node) const {
+        if (node == NULL_NODE) return 0;
+        return nodes[node].subtreeSize;
     }
 
-    shared_ptr<AVLNode> rightRotate(shared_ptr<AVLNode> y) {
-        shared_ptr<AVLNode> x = y->left;
-        shared_ptr<AVLNode> T2 = x->right;
-        x->right = y;
-        y->left = T2;
-        updateHeight(y);
-        updateHeight(x);
+    // Recomputes height and subtree size from the children
+    void updateNode(int32_t node) {
+        if (node == NULL_NODE) return;
+        AVLNode& current = nodes[node];
+        current.height = 1 + max(getHeight(current.left), getHeight(current.right));
+        current.subtreeSize = static_cast<uint32_t>(getSize(current.left) + getSize(current.right) +
+                                                    current.studentIds.size());
+    }
+
+    int32_t rightRotate(int32_t y) {
+        Metrics::add(Counter::Rotations);
+        int32_t x = nodes[y].left;
+        int32_t T2 = nodes[x].right;
+        nodes[x].right = y;
+        nodes[y].left = T2;
+        updateNode(y);
+        updateNode(x);
         return x;
     }
 
-    shared_ptr<AVLNode> leftRotate(shared_ptr<AVLNode> x) {
-        shared_ptr<AVLNode> y = x->right;
-        shared_ptr<AVLNode> T2 = y->left;
-        y->left = x;
-        x->right = T2;
-        updateHeight(x);
-        updateHeight(y);
+    int32_t leftRotate(int32_t x) {
+        Metrics::add(Counter::Rotations);
+        int32_t y = nodes[x].right;
+        int32_t T2 = nodes[y].left;
+        nodes[y].left = x;
+        nodes[x].right = T2;
+        updateNode(x);
+        updateNode(y);
         return y;
     }
 
-    shared_ptr<AVLNode> balanceNode(shared_ptr<AVLNode> node) {
-        if (!node) return nullptr;
-        updateHeight(node);
+    int32_t balanceNode(int32_t node) {
+        if (node == NULL_NODE) return NULL_NODE;
+        updateNode(node);
         int balance = getBalanceFactor(node);
 
-        if (balance > 1 && getBalanceFactor(node->left) >= 0) return rightRotate(node);
-        if (balance > 1 && getBalanceFactor(node->left) < 0) {
-            node->left = leftRotate(node->left);
+        if (balance > 1 && getBalanceFactor(nodes[node].left) >= 0) return rightRotate(node);
+        if (balance > 1 && getBalanceFactor(nodes[node].left) < 0) {
+            nodes[node].left = leftRotate(nodes[node].left);
             return rightRotate(node);
         }
-        if (balance < -1 && getBalanceFactor(node->right) <= 0) return leftRotate(node);
-        if (balance < -1 && getBalanceFactor(node->right) > 0) {
-            node->right = rightRotate(node->right);
+        if (balance < -1 && getBalanceFactor(nodes[node].right) <= 0) return leftRotate(node);
+        if (balance < -1 && getBalanceFactor(nodes[node].right) > 0) {
+            nodes[node].right = rightRotate(nodes[node].right);
             return leftRotate(node);
         }
         return node;
     }
-    
-    // Core insertion logic
-    shared_ptr<AVLNode> insertNode(shared_ptr<AVLNode> node, int attendance, int studentId) {
-        if (!node) return make_shared<AVLNode>(attendance, studentId);
-        if (attendance < node->attendance) {
-            node->left = insertNode(node->left, attendance, studentId);
-        } else if (attendance > node->attendance) {
-            node->right = insertNode(node->right, attendance, studentId);
+
+    // Core insertion logic (caller guarantees studentId is not in the tree yet)
+    int32_t insertNode(int32_t node, int attendance, int studentId) {
+        if (node == NULL_NODE) {
+            idIndex[studentId] = attendance;
+            return nodes.allocate(attendance, studentId);
+        }
+        Metrics::add(Counter::NodesVisited);
+        // Children are assigned after the recursive call returns, because an
+        // allocation below may move the pool.
+        if (attendance < nodes[node].attendance) {
+            int32_t child = insertNode(nodes[node].left, attendance, studentId);
+            nodes[node].left = child;
+        } else if (attendance > nodes[node].attendance) {
+            int32_t child = insertNode(nodes[node].right, attendance, studentId);
+            nodes[node].right = child;
         } else {
-            if (find(node->studentIds.begin(), node->studentIds.end(), studentId) == node->studentIds.end()) {
-                node->studentIds.push_back(studentId);
-            }
+            idIndex[studentId] = attendance;
+            nodes[node].studentIds.insert(studentId);
+            ++nodes[node].subtreeSize;
             return node;
         }
         return balanceNode(node);
     }
 
-    // --- Core BINARY Serialization Logic ---
-    void serializeHelper(ofstream& outFile, const shared_ptr<AVLNode>& node) {
-        if (!node) {
-            int nullMarker = -1;
-            outFile.write(reinterpret_cast<const char*>(&nullMarker), sizeof(int));
-            return;
+    // Standard AVL deletion of the node holding `attendance`; only the
+    // search path is rebalanced.
+    int32_t removeKey(int32_t node, int attendance) {
+        if (node == NULL_NODE) return NULL_NODE;
+        Metrics::add(Counter::NodesVisited);
+        AVLNode& current = nodes[node];
+        if (attendance < current.attendance) {
+            current.left = removeKey(current.left, attendance);
+        } else if (attendance > current.attendance) {
+            current.right = removeKey(current.right, attendance);
+        } else {
+            if (current.left == NULL_NODE || current.right == NULL_NODE) {
+                int32_t child = current.left != NULL_NODE ? current.left : current.right;
+                nodes.release(node);
+                return child;
+            }
+            int32_t successor = findMin(current.right);
+            current.attendance = nodes[successor].attendance;
+            current.studentIds = move(nodes[successor].studentIds);
+            current.right = removeKey(current.right, current.attendance);
         }
-        outFile.write(reinterpret_cast<const char*>(&node->attendance), sizeof(int));
-        size_t numIds = node->studentIds.size();
-        outFile.write(reinterpret_cast<const char*>(&numIds), sizeof(size_t));
-        for (const auto& id : node->studentIds) {
-            outFile.write(reinterpret_cast<const char*>(&id), sizeof(int));
+        return balanceNode(node);
+    }
+
+    // Drops a student via the side index: O(log n) descent (adjusting subtree
+    // sizes on the way) plus an O(log n) erase from the node's list. Returns
+    // false if the student is unknown.
+    bool removeStudentId(int studentId) {
+        auto located = idIndex.find(studentId);
+        if (located == idIndex.end()) return false;
+        int attendance = located->second;
+        idIndex.erase(located);
+
+        // Every node on the search path loses one student from its subtree
+        int32_t node = root;
+        uint64_t visited = 1;
+        while (nodes[node].attendance != attendance) {
+            --nodes[node].subtreeSize;
+            node = attendance < nodes[node].attendance ? nodes[node].left : nodes[node].right;
+            ++visited;
+        }
+        --nodes[node].subtreeSize;
+        Metrics::add(Counter::NodesVisited, visited);
+        PostingList& ids = nodes[node].studentIds;
+        ids.erase(studentId);
+        if (ids.empty()) root = removeKey(root, attendance);
+        return true;
+    }
+
+    // Fills a node's list with the IDs in [first, last) not placed yet,
+    // recording them in idIndex. A student listed under more than one key
+    // keeps only its first occurrence.
+    template <typename Iterator>
+    void placeIds(AVLNode& node, Iterator first, Iterator last) {
+        vector<int> kept;
+        kept.reserve(last - first);
+        for (auto id = first; id != last; ++id) {
+            if (idIndex.emplace(*id, node.attendance).second) kept.push_back(*id);
         }
-        outFile.write(reinterpret_cast<const char*>(&node->height), sizeof(int));
-        serializeHelper(outFile, node->left);
-        serializeHelper(outFile, node->right);
+        if (!is_sorted(kept.begin(), kept.end())) sort(kept.begin(), kept.end());
+        node.studentIds.assignSorted(kept.begin(), kept.end());
+    }
+
+    // Rebuilds idIndex and subtree sizes after loading a legacy tree.
+    void indexNode(int32_t node, const vector<vector<int>>& legacyIds) {
+        if (node == NULL_NODE) return;
+        AVLNode& current = nodes[node];
+        const vector<int>& ids = legacyIds[node];
+        placeIds(current, ids.begin(), ids.end());
+        indexNode(current.left, legacyIds);
+        indexNode(current.right, legacyIds);
+        updateNode(node);
+    }
+
+    // --- Flat Serialization Logic ---
+    // In-order walk emitting one FlatAVLKey per node, ascending by attendance.
+    void collectFlat(int32_t node, vector<FlatAVLKey>& keys, vector<int32_t>& ids) const {
+        if (node == NULL_NODE) return;
+        const AVLNode& current = nodes[node];
+        collectFlat(current.left, keys, ids);
+        keys.push_back({current.attendance, static_cast<uint32_t>(ids.size()),
+                        static_cast<uint32_t>(current.studentIds.size())});
+        current.studentIds.appendTo(ids);
+        collectFlat(current.right, keys, ids);
     }
 
-    // --- Core BINARY Deserialization Logic ---
-    shared_ptr<AVLNode> deserializeHelper(ifstream& inFile) {
+    // --- Legacy BINARY Deserialization Logic (pre-flat .dat files) ---
+    // The IDs of each node are collected in legacyIds (by pool index) and
+    // placed by indexNode once the whole tree is read.
+    int32_t deserializeHelper(ifstream& inFile, vector<vector<int>>& legacyIds) {
         int attendance;
-        inFile.read(reinterpret_cast<char*>(&attendance), sizeof(int));
-        if (attendance == -1) return nullptr;
-        
-        auto node = make_shared<AVLNode>(attendance);
+        if (!inFile.read(reinterpret_cast<char*>(&attendance), sizeof(int))) return NULL_NODE;
+        if (attendance == -1) return NULL_NODE;
+
+        int32_t node = nodes.allocate(attendance);
+        if (legacyIds.size() <= size_t(node)) legacyIds.resize(node + 1);
         size_t numIds;
         inFile.read(reinterpret_cast<char*>(&numIds), sizeof(size_t));
-        for (size_t i = 0; i < numIds; ++i) {
+        vector<int>& ids = legacyIds[node];
+        for (size_t i = 0; i < numIds && inFile; ++i) {
             int studentId;
             inFile.read(reinterpret_cast<char*>(&studentId), sizeof(int));
-            node->studentIds.push_back(studentId);
+            ids.push_back(studentId);
         }
-        inFile.read(reinterpret_cast<char*>(&node->height), sizeof(int));
-        node->left = deserializeHelper(inFile);
-        node->right = deserializeHelper(inFile);
+        inFile.read(reinterpret_cast<char*>(&nodes[node].height), sizeof(int));
+        int32_t left = deserializeHelper(inFile, legacyIds);
+        nodes[node].left = left;
+        int32_t right = deserializeHelper(inFile, legacyIds);
+        nodes[node].right = right;
         return node;
     }
-    
-    // --- Threshold Search Helper Logic ---
-    void collectStudentIds(const shared_ptr<AVLNode>& node, 
-                          int threshold, 
-                          int direction, 
-                          map<int, vector<int>, greater<int>>& result) {
-        if (!node) return;
-        if ((direction > 0 && node->attendance >= threshold) || 
-            (direction < 0 && node->attendance <= threshold)) {
-            result[node->attendance].insert(result[node->attendance].end(), 
-                                           node->studentIds.begin(), 
-                                           node->studentIds.end());
-        }
-        collectStudentIds(node->left, threshold, direction, result);
-        collectStudentIds(node->right, threshold, direction, result);
-    }
-    
-    // Helper functions for updateAttendance (must be declared)
-    shared_ptr<AVLNode> removeNode(shared_ptr<AVLNode> node);
-    shared_ptr<AVLNode> findMin(shared_ptr<AVLNode> node);
-    shared_ptr<AVLNode> removeStudentId(shared_ptr<AVLNode> node, int studentId);
-    
+
+    // --- Range Search Helper Logic ---
+    // Reverse in-order walk (highest attendance first) that only descends into
+    // subtrees which can still hold keys inside [lo, hi]: O(log n + k).
+    void collectRange(int32_t node, int lo, int hi, vector<int>& result) const {
+        if (node == NULL_NODE) return;
+        Metrics::add(Counter::NodesVisited);
+        const AVLNode& current = nodes[node];
+        if (current.attendance < hi) collectRange(current.right, lo, hi, result);
+        if (current.attendance >= lo && current.attendance <= hi) current.studentIds.appendTo(result);
+        if (current.attendance > lo) collectRange(current.left, lo, hi, result);
+    }
+
+    template <typename Visitor>
+    void visitInOrder(int32_t node, Visitor& visit) const {
+        if (node == NULL_NODE) return;
+        const AVLNode& current = nodes[node];
+        visitInOrder(current.left, visit);
+        current.studentIds.forEach([&](int studentId) { visit(current.attendance, studentId); });
+        visitInOrder(current.right, visit);
+    }
+
+    // --- Bulk Construction Logic ---
+    // Builds a perfectly balanced tree over groups [lo, hi), which must be
+    // sorted by attendance. groupAt(i) yields (attendance, first id, end id).
+    // Each group becomes one node, so the whole build is O(n log k) for
+    // groups of k IDs (sorting each list) with no rotations. A student
+    // already placed by an earlier group is skipped.
+    template <typename GroupAt>
+    int32_t buildBalanced(const GroupAt& groupAt, size_t lo, size_t hi) {
+        if (lo >= hi) return NULL_NODE;
+        size_t mid = lo + (hi - lo) / 2;
+        int32_t left = buildBalanced(groupAt, lo, mid);
+        int32_t right = buildBalanced(groupAt, mid + 1, hi);
+
+        auto [attendance, first, last] = groupAt(mid);
+        int32_t node = nodes.allocate(attendance);
+        AVLNode& current = nodes[node];
+        placeIds(current, first, last);
+        current.left = left;
+        current.right = right;
+        updateNode(node);
+        return node;
+    }
+
+    // Helper function for removeKey (must be declared)
+    int32_t findMin(int32_t node) const;
+
+    bool deserializeOnce(const string& filename);
+
 public:
-    AVLTree() : root(nullptr), studentFound(false) {}
+    AVLTree() : root(NULL_NODE), logGeneration(0) {}
 
+    // Inserting a student that is already present moves it to the new key.
     void insert(int attendance, int studentId) {
+        ScopedTimer timer(Phase::Insert);
+        auto located = idIndex.find(studentId);
+        if (located != idIndex.end()) {
+            if (located->second == attendance) return;
+            removeStudentId(studentId);
+        }
         root = insertNode(root, attendance, studentId);
     }
-    
+
+    size_t size() const {
+        return idIndex.size();
+    }
+
+    // Replaces the tree with (attendance, studentId) records in O(n + V) for
+    // V distinct attendance values in a bounded range (counting sort), falling
+    // back to a stable sort for sparse keys. As with repeated insert(), the
+    // last record for a student wins. Within a key, IDs are kept sorted.
+    void bulkLoad(const vector<pair<int, int>>& records);
+
     // Public Binary I/O Functions
-    bool serialize(const string& filename) {
-        ofstream outFile(filename, ios::binary);
-        if (!outFile) return false;
-        serializeHelper(outFile, root);
-        outFile.close();
+    // Writes a flat snapshot (see flat_format.h) one generation past the file
+    // on disk, replacing it atomically, then drops the update log it folds in.
+    bool serialize(const string& filename);
+
+    // Loads the snapshot (flat or legacy) and replays its update log on top.
+    // Returns false if neither a snapshot nor log records exist. Like
+    // AVLView::open, reloads if a writer compacted the file meanwhile, and
+    // fails if that keeps happening.
+    bool deserialize(const string& filename);
+
+    // Generation that update log records for this tree must carry
+    uint32_t generation() const {
+        return logGeneration;
+    }
+
+    // Function for update_avl.cpp: returns true if the student already existed
+    bool updateAttendance(int studentId, int newAttendance) {
+        ScopedTimer timer(Phase::Update);
+        bool studentFound = removeStudentId(studentId);
+        root = insertNode(root, newAttendance, studentId);
+        return studentFound;
+    }
+
+    // Function for threshold.cpp: IDs with lo <= attendance <= hi, highest
+    // attendance first and ascending by ID within an attendance
+    vector<int> getStudentIdsInRange(int lo, int hi) const {
+        ScopedTimer timer(Phase::Query);
+        vector<int> result;
+        if (lo > hi) return result;
+        collectRange(root, lo, hi, result);
+        return result;
+    }
+
+    // direction > 0: attendance >= threshold, direction < 0: attendance <= threshold
+    vector<int> getStudentIdsByThreshold(int threshold, int direction) const {
+        if (direction > 0) return getStudentIdsInRange(threshold, INT_MAX);
+        return getStudentIdsInRange(INT_MIN, threshold);
+    }
+
+    // Students with lo <= attendance <= hi, in O(log n)
+    size_t countInRange(int lo, int hi) const {
+        if (lo > hi) return 0;
+        return countAtMost(hi) - (lo == INT_MIN ? 0 : countAtMost(lo - 1));
+    }
+
+    size_t countByThreshold(int threshold, int direction) const {
+        if (direction > 0) return countInRange(threshold, INT_MAX);
+        return countInRange(INT_MIN, threshold);
+    }
+
+    // Students with attendance <= value
+    size_t countAtMost(int value) const {
+        size_t count = 0, visited = 0;
+        for (int32_t node = root; node != NULL_NODE; ++visited) {
+            const AVLNode& current = nodes[node];
+            if (value < current.attendance) {
+                node = current.left;
+            } else {
+                count += getSize(current.left) + current.studentIds.size();
+                node = current.right;
+            }
+        }
+        Metrics::add(Counter::NodesVisited, visited);
+        return count;
+    }
+
+    bool attendanceOf(int studentId, int& attendance) const {
+        auto located = idIndex.find(studentId);
+        if (located == idIndex.end()) return false;
+        attendance = located->second;
         return true;
     }
 
-    bool deserialize(const string& filename) {
+    // The k-th student (0-based) in ascending attendance order; students
+    // with equal attendance are ordered by ID. False if k >= size().
+    bool kthSmallest(size_t k, int& attendance, int& studentId) const {
+        int32_t node = root;
+        while (node != NULL_NODE) {
+            Metrics::add(Counter::NodesVisited);
+            const AVLNode& current = nodes[node];
+            size_t leftSize = getSize(current.left);
+            if (k < leftSize) {
+                node = current.left;
+            } else if (k < leftSize + current.studentIds.size()) {
+                attendance = current.attendance;
+                studentId = current.studentIds.at(k - leftSize);
+                return true;
+            } else {
+                k -= leftSize + current.studentIds.size();
+                node = current.right;
+            }
+        }
+        return false;
+    }
+
+    // Nearest-rank percentile (0 < p <= 100): the smallest attendance that at
+    // least p% of students are at or below. False for an empty tree.
+    bool percentile(double p, int& attendance) const {
+        if (idIndex.empty() || !(p > 0.0) || p > 100.0) return false;
+        size_t rank = static_cast<size_t>(ceil(p / 100.0 * idIndex.size()));
+        int studentId;
+        return kthSmallest(max<size_t>(rank, 1) - 1, attendance, studentId);
+    }
+
+    // Calls visit(attendance, studentId) for every student, lowest attendance first
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        visitInOrder(root, visit);
+    }
+};
+
+// --- IMPLEMENTATIONS (Kept here for simplicity, typically go in a CPP file) ---
+
+int32_t AVLTree::findMin(int32_t node) const {
+    if (node == NULL_NODE) return NULL_NODE;
+    while (nodes[node].left != NULL_NODE) node = nodes[node].left;
+    return node;
+}
+
+// Zero-copy reader for flat AVL index files: queries run directly on the
+// mapped arrays without building a tree. Pending update log records are kept
+// in a small overlay so results match a fully loaded tree.
+class AVLView {
+private:
+    MappedFile file;
+    const FlatAVLKey* keys;
+    IdPoolView ids;
+    uint32_t keyCount;
+    uint32_t logGeneration;
+    unordered_map<int, int> overlay;  // studentId -> attendance from the update log
+
+public:
+    AVLView() : keys(nullptr), keyCount(0), logGeneration(0) {}
+
+    static bool isFlat(const string& filename) {
+        return hasFlatMagic(filename, "AVLX");
+    }
+
+    // Format version of a flat file, or 0 for missing and legacy files.
+    static uint32_t readVersion(const string& filename) {
+        ifstream inFile(filename, ios::binary);
+        FlatAVLHeader header;
+        if (!inFile.read(reinterpret_cast<char*>(&header), flatAVLHeaderSize(1)) ||
+            memcmp(header.magic, "AVLX", 4) != 0) return 0;
+        return header.version;
+    }
+
+    // Snapshot generation of a flat file; 0 for missing, legacy or v1 files.
+    static uint32_t readGeneration(const string& filename) {
         ifstream inFile(filename, ios::binary);
-        if (!inFile) return false;
-        root = deserializeHelper(inFile);
-        inFile.close();
+        FlatAVLHeader header;
+        if (!inFile.read(reinterpret_cast<char*>(&header), flatAVLHeaderSize(2))) return 0;
+        if (memcmp(header.magic, "AVLX", 4) != 0 || header.version < 2) return 0;
+        return header.logGeneration;
+    }
+
+    // Fails for missing, legacy or malformed files. With the log, the
+    // snapshot generation is checked again once the log has been read: if a
+    // writer compacted in between (new snapshot renamed in, old log removed),
+    // the file is mapped again, so an old snapshot is never paired with a
+    // log that has already been folded away. Gives up (false) if the
+    // generation still moved on the 8th attempt.
+    bool open(const string& filename, bool withLog = true) {
+        for (int attempt = 1;; ++attempt) {
+            if (!openOnce(filename, withLog)) return false;
+            if (!withLog || readGeneration(filename) == logGeneration) return true;
+            if (attempt == 8) {
+                keyCount = 0;
+                overlay.clear();
+                return false;
+            }
+        }
+    }
+
+private:
+    bool openOnce(const string& filename, bool withLog) {
+        keyCount = 0;
+        overlay.clear();
+        if (!file.open(filename)) return false;
+        const char* bytes = file.data();
+        size_t length = file.size();
+        if (!hasFlatMagic(bytes, length, "AVLX") || length < flatAVLHeaderSize(1)) return false;
+
+        FlatAVLHeader header = {};
+        memcpy(&header, bytes, flatAVLHeaderSize(1));
+        if (header.version < 1 || header.version > FLAT_AVL_VERSION) return false;
+        size_t headerSize = flatAVLHeaderSize(header.version);
+        if (length < headerSize) return false;
+        memcpy(&header, bytes, headerSize);
+
+        uint64_t poolOffset = headerSize + uint64_t(header.keyCount) * sizeof(FlatAVLKey);
+        uint64_t needed = poolOffset + (header.version < 3 ? uint64_t(header.idCount) * sizeof(int32_t)
+                                                           : IdPoolView::blockTableSize(header.idCount) + header.idBytes);
+        if (needed > length) return false;
+
+        keys = reinterpret_cast<const FlatAVLKey*>(bytes + headerSize);
+        if (header.version < 3) {
+            ids.openPlain(reinterpret_cast<const int32_t*>(bytes + poolOffset), header.idCount);
+        } else {
+            ids.openCompressed(bytes + poolOffset, header.idCount, header.idBytes);
+        }
+        for (uint32_t i = 0; i < header.keyCount; ++i) {
+            if (uint64_t(keys[i].idBegin) + keys[i].idCount > header.idCount) return false;
+            if (i > 0 && keys[i - 1].attendance >= keys[i].attendance) return false;
+        }
+        keyCount = header.keyCount;
+        logGeneration = header.logGeneration;
+
+        if (withLog) {
+            for (const UpdateRecord& record : UpdateLog::read(filename, logGeneration)) {
+                overlay[record.studentId] = record.attendance;
+            }
+        }
         return true;
     }
-    
-    // Function for update_avl.cpp
-    bool updateAttendance(int studentId, int newAttendance) {
-        studentFound = false;
-        root = removeStudentId(root, studentId);
-        root = insertNode(root, newAttendance, studentId);
-        return studentFound;
+
+public:
+
+    uint32_t size() const { return keyCount; }
+    uint32_t generation() const { return logGeneration; }
+    const FlatAVLKey& key(uint32_t i) const { return keys[i]; }
+
+    // Appends the snapshot IDs of a key, ascending in version 3 files.
+    void appendIdsOf(const FlatAVLKey& entry, vector<int>& out) const {
+        ids.appendTo(entry.idBegin, entry.idBegin + entry.idCount, out);
     }
-    
-    // Function for threshold.cpp
-    vector<int> getStudentIdsByThreshold(int threshold, int direction) {
-        map<int, vector<int>, greater<int>> attendanceMap;
-        collectStudentIds(root, threshold, direction, attendanceMap);
+
+    // The overlay, then one skip-table search per key: O(k log n) for k
+    // keys (a scan for files older than version 3), never deserializing.
+    bool contains(int studentId) const {
+        if (overlay.count(studentId)) return true;
+        for (uint32_t i = 0; i < keyCount; ++i) {
+            if (ids.contains(keys[i].idBegin, keys[i].idBegin + keys[i].idCount, studentId)) return true;
+        }
+        return false;
+    }
+
+    // Same contract as AVLTree::getStudentIdsInRange: binary search for hi,
+    // then walk keys downwards until lo. Students moved by the update log are
+    // skipped in the snapshot and merged back in, in ID order, at their new
+    // attendance.
+    vector<int> getStudentIdsInRange(int lo, int hi) const {
+        ScopedTimer timer(Phase::Query);
         vector<int> result;
-        for (const auto& [attendance, ids] : attendanceMap) {
-            result.insert(result.end(), ids.begin(), ids.end());
+        if (lo > hi) return result;
+
+        vector<pair<int, int>> moved;  // (attendance, studentId) from the overlay
+        for (const auto& [studentId, attendance] : overlay) {
+            if (attendance >= lo && attendance <= hi) moved.push_back({attendance, studentId});
         }
+        sort(moved.begin(), moved.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        auto pending = moved.begin();
+
+        const FlatAVLKey* end = upper_bound(keys, keys + keyCount, hi,
+            [](int value, const FlatAVLKey& entry) { return value < entry.attendance; });
+        const FlatAVLKey* it = end;
+        for (; it != keys && (it - 1)->attendance >= lo; --it) {
+            const FlatAVLKey& entry = *(it - 1);
+            for (; pending != moved.end() && pending->first > entry.attendance; ++pending) {
+                result.push_back(pending->second);
+            }
+            if (overlay.empty()) {
+                appendIdsOf(entry, result);
+                continue;
+            }
+            size_t keyStart = result.size();
+            ids.forEach(entry.idBegin, entry.idBegin + entry.idCount, [&](int32_t id) {
+                if (!overlay.count(id)) result.push_back(id);
+                return true;
+            });
+            size_t keyMiddle = result.size();
+            for (; pending != moved.end() && pending->first == entry.attendance; ++pending) {
+                result.push_back(pending->second);
+            }
+            if (ids.sortedRuns()) {
+                inplace_merge(result.begin() + keyStart, result.begin() + keyMiddle, result.end());
+            }
+        }
+        for (; pending != moved.end(); ++pending) result.push_back(pending->second);
+        Metrics::add(Counter::NodesVisited, end - it);  // keys walked
         return result;
     }
+
+    vector<int> getStudentIdsByThreshold(int threshold, int direction) const {
+        if (direction > 0) return getStudentIdsInRange(threshold, INT_MAX);
+        return getStudentIdsInRange(INT_MIN, threshold);
+    }
+
+    // Same contract as AVLTree::countInRange, from the ID counts of the keys
+    // in range without decoding any ID: O(log n + k) for k keys. Each student
+    // moved by the update log also costs one ID lookup per key in range.
+    size_t countInRange(int lo, int hi) const {
+        ScopedTimer timer(Phase::Query);
+        if (lo > hi) return 0;
+        const FlatAVLKey* first = lower_bound(keys, keys + keyCount, lo,
+            [](const FlatAVLKey& entry, int value) { return entry.attendance < value; });
+        const FlatAVLKey* last = upper_bound(first, keys + keyCount, hi,
+            [](int value, const FlatAVLKey& entry) { return value < entry.attendance; });
+        size_t count = 0;
+        for (const FlatAVLKey* it = first; it != last; ++it) count += it->idCount;
+        for (const auto& [studentId, attendance] : overlay) {
+            if (attendance >= lo && attendance <= hi) ++count;
+            for (const FlatAVLKey* it = first; it != last; ++it) {
+                if (ids.contains(it->idBegin, it->idBegin + it->idCount, studentId)) {
+                    --count;  // counted above at its snapshot attendance
+                    break;
+                }
+            }
+        }
+        Metrics::add(Counter::NodesVisited, last - first);  // keys summed
+        return count;
+    }
+
+    size_t countByThreshold(int threshold, int direction) const {
+        if (direction > 0) return countInRange(threshold, INT_MAX);
+        return countInRange(INT_MIN, threshold);
+    }
 };
 
-// --- IMPLEMENTATIONS (Kept here for simplicity, typically go in a CPP file) ---
+// Writes sorted keys and their ID pool as a flat snapshot one generation past
+// both logGeneration and the file on disk, replacing it atomically, then drops
+// the update log it folds in. Shared by every in-memory attendance index.
+bool writeFlatAVL(const string& filename, const vector<FlatAVLKey>& keys, const vector<int32_t>& ids,
+                  uint32_t& logGeneration) {
+    uint32_t generation = max(logGeneration, AVLView::readGeneration(filename)) + 1;
+    vector<FlatIdBlock> blocks;
+    vector<uint8_t> idBytes;
+    encodeIdPool(ids, blocks, idBytes);
+    FlatAVLHeader header = {{'A', 'V', 'L', 'X'}, FLAT_AVL_VERSION, static_cast<uint32_t>(keys.size()),
+                            static_cast<uint32_t>(ids.size()), generation, static_cast<uint32_t>(idBytes.size())};
+    vector<char> contents;
+    contents.reserve(sizeof(header) + keys.size() * sizeof(FlatAVLKey) + blocks.size() * sizeof(FlatIdBlock) +
+                     paddedTo4(idBytes.size()));
+    appendRecord(contents, header);
+    appendRecords(contents, keys);
+    appendRecords(contents, blocks);
+    contents.insert(contents.end(), idBytes.begin(), idBytes.end());
+    contents.resize(paddedTo4(contents.size()), '\0');
+    if (!writeFileAtomically(filename, contents)) return false;
 
-shared_ptr<AVLNode> AVLTree::removeNode(shared_ptr<AVLNode> node) {
-    if (!node->left) return node->right;
-    if (!node->right) return node->left;
-    shared_ptr<AVLNode> successor = findMin(node->right);
-    node->attendance = successor->attendance;
-    node->studentIds = successor->studentIds;
-    node->right = removeNode(successor);
-    return balanceNode(node);
+    // The old log no longer matches the new generation, so removing it is
+    // only housekeeping.
+    logGeneration = generation;
+    UpdateLog::remove(filename);
+    return true;
 }
 
-shared_ptr<AVLNode> AVLTree::findMin(shared_ptr<AVLNode> node) {
-    if (!node) return nullptr;
-    while (node->left) node = node->left;
-    return node;
+bool AVLTree::serialize(const string& filename) {
+    ScopedTimer timer(Phase::Serialize);
+    vector<FlatAVLKey> keys;
+    vector<int32_t> ids;
+    collectFlat(root, keys, ids);
+    return writeFlatAVL(filename, keys, ids, logGeneration);
 }
 
-shared_ptr<AVLNode> AVLTree::removeStudentId(shared_ptr<AVLNode> node, int studentId) {
-    if (!node) return nullptr;
-    
-    auto it = find(node->studentIds.begin(), node->studentIds.end(), studentId);
-    if (it != node->studentIds.end()) {
-        studentFound = true;
-        node->studentIds.erase(it);
-        if (node->studentIds.empty()) return removeNode(node);
-        return node;
+bool AVLTree::deserialize(const string& filename) {
+    ScopedTimer timer(Phase::Deserialize);
+    for (int attempt = 1;; ++attempt) {
+        if (!deserializeOnce(filename)) return false;
+        if (!AVLView::isFlat(filename) || AVLView::readGeneration(filename) == logGeneration) return true;
+        if (attempt == 8) return false;  // still racing compactions
     }
-    
-    node->left = removeStudentId(node->left, studentId);
-    node->right = removeStudentId(node->right, studentId);
-    return balanceNode(node);
+}
+
+bool AVLTree::deserializeOnce(const string& filename) {
+    nodes.clear();
+    idIndex.clear();
+    root = NULL_NODE;
+    logGeneration = 0;
+    bool snapshotFound = false;
+
+    if (AVLView::isFlat(filename)) {
+        AVLView view;
+        if (!view.open(filename, false)) return false;
+        // Keys are stored sorted, so the tree is rebuilt bottom-up in O(n).
+        nodes.reserve(view.size());
+        idIndex.reserve(view.size() == 0 ? 0 : view.key(view.size() - 1).idBegin + view.key(view.size() - 1).idCount);
+        vector<int> keyIds;
+        root = buildBalanced([&view, &keyIds](size_t i) {
+            const FlatAVLKey& entry = view.key(static_cast<uint32_t>(i));
+            keyIds.clear();
+            view.appendIdsOf(entry, keyIds);
+            return make_tuple(entry.attendance, keyIds.cbegin(), keyIds.cend());
+        }, 0, view.size());
+        logGeneration = view.generation();
+        snapshotFound = true;
+    } else {
+        ifstream inFile(filename, ios::binary);
+        if (inFile) {
+            vector<vector<int>> legacyIds;
+            root = deserializeHelper(inFile, legacyIds);
+            legacyIds.resize(nodes.size());
+            inFile.clear();
+            Metrics::add(Counter::BytesRead, static_cast<uint64_t>(max<streamoff>(inFile.tellg(), 0)));
+            inFile.close();
+            indexNode(root, legacyIds);
+            snapshotFound = true;
+        }
+    }
+
+    vector<UpdateRecord> records = UpdateLog::read(filename, logGeneration);
+    for (const UpdateRecord& record : records) {
+        updateAttendance(record.studentId, record.attendance);
+    }
+    return snapshotFound || !records.empty();
+}
+
+void AVLTree::bulkLoad(const vector<pair<int, int>>& records) {
+    ScopedTimer timer(Phase::Build);
+    nodes.clear();
+    idIndex.clear();
+    root = NULL_NODE;
+    if (records.empty()) return;
+
+    // Keep only the last record per student.
+    vector<char> keep(records.size(), 0);
+    unordered_set<int> seen;
+    seen.reserve(records.size());
+    int minAttendance = INT_MAX, maxAttendance = INT_MIN;
+    for (size_t i = records.size(); i-- > 0;) {
+        if (seen.insert(records[i].second).second) {
+            keep[i] = 1;
+            minAttendance = min(minAttendance, records[i].first);
+            maxAttendance = max(maxAttendance, records[i].first);
+        }
+    }
+
+    // Group IDs by attendance: groupAttendance[g] owns ids[groupBegin[g], groupBegin[g + 1]).
+    vector<int> groupAttendance;
+    vector<uint32_t> groupBegin;
+    vector<int> ids(seen.size());
+    uint64_t span = uint64_t(int64_t(maxAttendance) - minAttendance) + 1;
+    if (span <= 2 * uint64_t(records.size()) + 1024) {
+        vector<uint32_t> counts(span + 1, 0);
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (keep[i]) ++counts[records[i].first - minAttendance + 1];
+        }
+        for (size_t v = 1; v <= span; ++v) {
+            if (counts[v] > 0) {
+                groupAttendance.push_back(static_cast<int>(minAttendance + int64_t(v) - 1));
+                groupBegin.push_back(counts[v - 1]);
+            }
+            counts[v] += counts[v - 1];
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (keep[i]) ids[counts[records[i].first - minAttendance]++] = records[i].second;
+        }
+    } else {
+        vector<pair<int, int>> sorted;
+        sorted.reserve(ids.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (keep[i]) sorted.push_back(records[i]);
+        }
+        stable_sort(sorted.begin(), sorted.end(),
+                    [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || sorted[i].first != sorted[i - 1].first) {
+                groupAttendance.push_back(sorted[i].first);
+                groupBegin.push_back(static_cast<uint32_t>(i));
+            }
+            ids[i] = sorted[i].second;
+        }
+    }
+    groupBegin.push_back(static_cast<uint32_t>(ids.size()));
+
+    nodes.reserve(groupAttendance.size());
+    idIndex.reserve(ids.size());
+    root = buildBalanced([&](size_t g) {
+        return make_tuple(groupAttendance[g], ids.data() + groupBegin[g], ids.data() + groupBegin[g + 1]);
+    }, 0, groupAttendance.size());
+}
+
+// Reads a whole stream in large chunks (one allocation-amortized buffer
+// instead of a getline + stringstream per record).
+string readAllInput(FILE* stream) {
+    string data;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), stream)) > 0) data.append(chunk, n);
+    return data;
+}
+
+// Parses "<attendance> <student_id>" lines without iostreams. Malformed
+// lines are skipped and returned through invalidLines when given.
+vector<pair<int, int>> parseAttendanceRecords(const string& data, vector<string>* invalidLines = nullptr) {
+    vector<pair<int, int>> records;
+    const char* p = data.data();
+    const char* end = p + data.size();
+
+    auto parseInt = [&](const char*& cursor, const char* lineEnd, int& value) {
+        while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t')) ++cursor;
+        bool negative = cursor < lineEnd && *cursor == '-';
+        if (negative) ++cursor;
+        const char* digits = cursor;
+        int64_t result = 0;
+        while (cursor < lineEnd && *cursor >= '0' && *cursor <= '9' && result <= INT_MAX) {
+            result = result * 10 + (*cursor++ - '0');
+        }
+        if (cursor == digits || result > INT_MAX) return false;
+        value = static_cast<int>(negative ? -result : result);
+        return true;
+    };
+
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+        const char* cursor = p;
+        int attendance, studentId;
+        bool valid = parseInt(cursor, lineEnd, attendance) && parseInt(cursor, lineEnd, studentId);
+        while (valid && cursor < lineEnd && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')) ++cursor;
+        if (valid && cursor == lineEnd) {
+            records.push_back({attendance, studentId});
+        } else {
+            bool blank = true;
+            for (const char* c = p; c < lineEnd; ++c) {
+                if (*c != ' ' && *c != '\t' && *c != '\r') blank = false;
+            }
+            if (!blank && invalidLines) invalidLines->emplace_back(p, lineEnd);
+        }
+        p = lineEnd + 1;
+    }
+    return records;
 }
 
 AVLTree buildAVLTree() {
@@ -246,4 +864,4 @@ AVLTree buildAVLTree() {
         tree.insert(attendance, studentId);
     }
     return tree;
-}
\ No newline at end of file
+}
@@ -0,0 +1,90 @@
+#include "../avl.h"
+#include "../bucket_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+// Attendance index backends: AVLTree versus BucketIndex (per-value buckets
+// plus a Fenwick tree), on identical workloads for a subject-sized domain
+// (0..100) and a total_attendance-sized one (0..500).
+//
+// Usage: ./bench_index [students] [updates]
+
+template <typename Function>
+static double millis(Function&& function) {
+    auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+struct Timings {
+    double buildMs, updateUs, enumerateMs, countUs;
+};
+
+template <typename Index>
+static Timings run(Index& index, const vector<pair<int, int>>& roster, const vector<pair<int, int>>& updates,
+                   const vector<int>& thresholds, size_t& checksum) {
+    Timings timings;
+    timings.buildMs = millis([&] {
+        for (const auto& [attendance, studentId] : roster) index.updateAttendance(studentId, attendance);
+    });
+    timings.updateUs = millis([&] {
+        for (const auto& [studentId, attendance] : updates) index.updateAttendance(studentId, attendance);
+    }) * 1000.0 / updates.size();
+    timings.enumerateMs = millis([&] {
+        for (int threshold : thresholds) checksum += index.getStudentIdsByThreshold(threshold, 1).size();
+    }) / thresholds.size();
+    // AVLTree counts from its subtree sizes; BucketIndex reads its Fenwick tree.
+    size_t counted = 0;
+    timings.countUs = millis([&] {
+        for (int threshold : thresholds) counted += index.countByThreshold(threshold, -1);
+    }) * 1000.0 / thresholds.size();
+    checksum += counted;
+    return timings;
+}
+
+int main(int argc, char* argv[]) {
+    int students = argc > 1 ? stoi(argv[1]) : 1000000;
+    int updateCount = argc > 2 ? stoi(argv[2]) : 1000000;
+
+    printf("%-8s %-7s %10s %12s %14s %12s\n", "domain", "index", "build ms", "update us", "enumerate ms", "count us");
+    for (int maxValue : {100, 500}) {
+        mt19937 rng(42);
+        uniform_int_distribution<int> attendance(0, maxValue);
+        uniform_int_distribution<int> pick(0, students - 1);
+        vector<pair<int, int>> roster, updates;
+        for (int i = 0; i < students; ++i) roster.push_back({attendance(rng), 100000 + i});
+        for (int i = 0; i < updateCount; ++i) updates.push_back({100000 + pick(rng), attendance(rng)});
+        vector<int> thresholds;
+        for (int i = 0; i < 50; ++i) thresholds.push_back(attendance(rng));
+
+        AVLTree tree;
+        BucketIndex buckets;
+        size_t treeChecksum = 0, bucketChecksum = 0;
+        Timings avl = run(tree, roster, updates, thresholds, treeChecksum);
+        Timings bucket = run(buckets, roster, updates, thresholds, bucketChecksum);
+
+        for (int threshold = 0; threshold <= maxValue; threshold += 7) {
+            vector<int> expected = tree.getStudentIdsInRange(threshold, threshold + 10);
+            vector<int> actual = buckets.getStudentIdsInRange(threshold, threshold + 10);
+            sort(expected.begin(), expected.end());
+            sort(actual.begin(), actual.end());
+            if (expected != actual || treeChecksum != bucketChecksum) {
+                cerr << "Mismatch between AVLTree and BucketIndex for domain 0.." << maxValue << endl;
+                return 1;
+            }
+        }
+
+        const string domain = "0.." + to_string(maxValue);
+        printf("%-8s %-7s %10.1f %12.3f %14.3f %12.3f\n", domain.c_str(), "avl",
+               avl.buildMs, avl.updateUs, avl.enumerateMs, avl.countUs);
+        printf("%-8s %-7s %10.1f %12.3f %14.3f %12.3f\n", domain.c_str(), "bucket",
+               bucket.buildMs, bucket.updateUs, bucket.enumerateMs, bucket.countUs);
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "../avl.h"
+#include "../trie.h"
+#include "legacy_avl.h"
+#include "legacy_trie.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+// Node layout microbenchmark: pooled, index-linked AVLTree/Trie versus the
+// original shared_ptr versions in legacy::, on identical workloads.
+//
+// Usage: ./bench_nodes [students]
+
+static const vector<string> FIRST_NAMES = {
+    "Aarav", "Aarohi", "Aditya", "Ananya", "Arjun", "Diya", "Ishaan", "Kavya",
+    "Meera", "Neha", "Pranav", "Riya", "Rohan", "Saanvi", "Vihaan", "Zara"
+};
+static const vector<string> LAST_NAMES = {
+    "Mehta", "Saxena", "Sharma", "Gupta", "Iyer", "Kapoor", "Nair", "Patel",
+    "Reddy", "Singh", "Verma", "Joshi", "Malhotra", "Banerjee", "Chopra", "Das"
+};
+
+template <typename Function>
+static double millis(Function&& function) {
+    auto start = chrono::steady_clock::now();
+    function();
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static void report(const char* phase, size_t ops, double pooledMs, double legacyMs) {
+    printf("%-14s %12.0f %12.0f %8.2fx\n", phase,
+           ops / (pooledMs / 1000.0), ops / (legacyMs / 1000.0), legacyMs / pooledMs);
+}
+
+int main(int argc, char* argv[]) {
+    int students = argc > 1 ? stoi(argv[1]) : 200000;
+    mt19937 rng(7);
+    uniform_int_distribution<int> attendance(0, 100);
+    uniform_int_distribution<int> pick(0, students - 1);
+
+    vector<string> names;
+    vector<pair<int, int>> roster;
+    for (int i = 0; i < students; ++i) {
+        names.push_back(FIRST_NAMES[rng() % FIRST_NAMES.size()] + " " +
+                        LAST_NAMES[rng() % LAST_NAMES.size()] + " " + to_string(rng() % 100000));
+        roster.push_back({attendance(rng), 100000 + i});
+    }
+    vector<string> prefixes;
+    for (int i = 0; i < 2000; ++i) {
+        const string& name = names[pick(rng)];
+        prefixes.push_back(name.substr(0, 3 + rng() % 8));
+    }
+    vector<pair<int, int>> updates;
+    for (int i = 0; i < 2000; ++i) updates.push_back({100000 + pick(rng), attendance(rng)});
+
+    printf("%d students\n", students);
+    printf("%-14s %12s %12s %9s\n", "phase", "pooled op/s", "legacy op/s", "speedup");
+
+    Trie trie;
+    legacy::Trie legacyTrie;
+    double pooled = millis([&] { for (int i = 0; i < students; ++i) trie.insert(names[i], i); });
+    double shared = millis([&] { for (int i = 0; i < students; ++i) legacyTrie.insert(names[i], to_string(i)); });
+    report("trie build", students, pooled, shared);
+
+    size_t pooledHits = 0, legacyHits = 0;
+    pooled = millis([&] { for (const auto& prefix : prefixes) pooledHits += trie.search(prefix).size(); });
+    shared = millis([&] { for (const auto& prefix : prefixes) legacyHits += legacyTrie.search(prefix).size(); });
+    report("trie search", prefixes.size(), pooled, shared);
+
+    AVLTree tree;
+    legacy::AVLTree legacyTree;
+    pooled = millis([&] { for (const auto& [a, id] : roster) tree.insert(a, id); });
+    shared = millis([&] { for (const auto& [a, id] : roster) legacyTree.insert(a, id); });
+    report("avl build", students, pooled, shared);
+
+    pooled = millis([&] { for (int t = 0; t <= 100; ++t) pooledHits += tree.getStudentIdsByThreshold(t, -1).size(); });
+    shared = millis([&] { for (int t = 0; t <= 100; ++t) legacyHits += legacyTree.getStudentIdsByThreshold(t, -1).size(); });
+    report("avl threshold", 101, pooled, shared);
+
+    // The legacy update also pays its O(n) scan, so this row mixes layout and algorithm.
+    pooled = millis([&] { for (const auto& [id, a] : updates) tree.updateAttendance(id, a); });
+    shared = millis([&] { for (const auto& [id, a] : updates) legacyTree.updateAttendance(id, a); });
+    report("avl update", updates.size(), pooled, shared);
+
+    if (pooledHits != legacyHits) {
+        cerr << "Result mismatch: " << pooledHits << " vs " << legacyHits << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,396 @@
+#include "../columnar.h"
+#include "../token_index.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Regression benchmark for the command-line tools, run on a roster from
+// gen_roster (or executable/data). Each operation repeats the work its tool
+// does after startup, against files in <work_dir>:
+//   create_avl    bulk-build one column's tree and serialize it (per column)
+//   create_trie   insert every name and serialize the trie
+//   update_avl    lock, map the snapshot, append one log record, compacting
+//                 once the log reaches ATTENDANCE_WAL_MAX_RECORDS
+//   threshold     map maths.dat and list the students above/below a random mark
+//   search_trie   map name.dat and look up a random name prefix
+//   search_tokens map name_tokens.dat and look up prefixes of two random name
+//                 parts, intersecting their posting lists (token_index.h)
+// and reports p50/p99 latency per call, throughput, and the peak RSS of the
+// process that ran it. Every operation runs in its own forked process (which
+// also loads the roster), so peak RSS is per operation, as for the tools.
+// Process start-up and argument parsing are not included.
+//
+// Usage: ./bench_suite [--ops N] [--repeat R] [--only op,...] [--json] [--work-dir dir] <roster_dir>
+
+struct Roster {
+    vector<int> studentIds;
+    vector<string> names;
+    vector<vector<int>> columns;  // columns[c][row], subjects then total_attendance
+};
+
+struct Options {
+    int ops = 1000;
+    int repeat = 3;
+    string workDir;
+};
+
+// What a child reports back through its pipe
+struct OpResult {
+    int failed;
+    uint64_t samples;
+    double p50Us, p99Us, throughput;
+};
+
+struct Samples {
+    vector<double> micros;  // one latency per call
+    double items = 0;       // records, names or calls processed, for throughput
+};
+
+static const vector<string> OPERATIONS = {"create_avl", "create_trie", "update_avl", "threshold", "search_trie",
+                                          "search_tokens"};
+
+template <typename Function>
+static double micros(Function&& function) {
+    auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+static bool loadRoster(const string& filename, Roster& roster) {
+    ColumnarStore layout;
+    CSVReader csv;
+    if (!csv.open(filename) || !csv.next()) return false;
+    const size_t fieldCount = csv.size();
+    vector<int> fieldOf(layout.columnCount(), -1);
+    for (size_t c = 0; c < layout.columnCount(); ++c) {
+        fieldOf[c] = csv.find(layout.name(c));
+        if (fieldOf[c] < 0) return false;
+    }
+    roster.columns.assign(layout.columnCount(), {});
+    while (csv.next()) {
+        if (csv.size() < fieldCount) continue;
+        int studentId;
+        if (!parseCSVInt(csv[0], studentId)) return false;
+        roster.studentIds.push_back(studentId);
+        roster.names.emplace_back(csv[1]);
+        for (size_t c = 0; c < fieldOf.size(); ++c) {
+            int value;
+            if (!parseCSVInt(csv[fieldOf[c]], value)) return false;
+            roster.columns[c].push_back(value);
+        }
+    }
+    return !roster.studentIds.empty();
+}
+
+static vector<pair<int, int>> columnRecords(const Roster& roster, size_t column) {
+    vector<pair<int, int>> records;
+    records.reserve(roster.studentIds.size());
+    for (size_t row = 0; row < roster.studentIds.size(); ++row) {
+        records.push_back({roster.columns[column][row], roster.studentIds[row]});
+    }
+    return records;
+}
+
+static bool buildAVL(const vector<pair<int, int>>& records, const string& datFilename) {
+    AVLTree tree;
+    tree.bulkLoad(records);
+    WriterLock lock(datFilename);
+    return lock.held() && tree.serialize(datFilename);
+}
+
+static bool buildTrie(const Roster& roster, const string& trieFilename) {
+    Trie trie;
+    for (size_t row = 0; row < roster.names.size(); ++row) trie.insert(roster.names[row], roster.studentIds[row]);
+    return trie.serialize(trieFilename);
+}
+
+static bool buildTokenIndexFile(const Roster& roster, const string& tokensFilename) {
+    Trie tokens;
+    for (size_t row = 0; row < roster.names.size(); ++row) {
+        insertNameTokens(tokens, roster.names[row], roster.studentIds[row]);
+    }
+    return tokens.serialize(tokensFilename);
+}
+
+static bool runCreateAVL(const Roster& roster, const Options& options, Samples& samples) {
+    ColumnarStore layout;
+    for (int r = 0; r < options.repeat; ++r) {
+        for (size_t c = 0; c < layout.columnCount(); ++c) {
+            vector<pair<int, int>> records = columnRecords(roster, c);
+            bool built = true;
+            samples.micros.push_back(micros([&] {
+                built = buildAVL(records, layout.snapshotFile(options.workDir, c));
+            }));
+            if (!built) return false;
+            samples.items += records.size();
+        }
+    }
+    return true;
+}
+
+static bool runCreateTrie(const Roster& roster, const Options& options, Samples& samples) {
+    for (int r = 0; r < options.repeat; ++r) {
+        bool built = true;
+        samples.micros.push_back(micros([&] { built = buildTrie(roster, options.workDir + "/name.dat"); }));
+        if (!built) return false;
+        samples.items += roster.names.size();
+    }
+    return true;
+}
+
+// maths.dat and name.dat are built (untimed) when an operation needs them
+// and create_avl/create_trie did not run first.
+static string mathsFile(const Roster& roster, const Options& options) {
+    const string datFilename = options.workDir + "/maths.dat";
+    if (!AVLView::isFlat(datFilename)) buildAVL(columnRecords(roster, 0), datFilename);
+    return datFilename;
+}
+
+static bool runUpdateAVL(const Roster& roster, const Options& options, Samples& samples) {
+    const string datFilename = mathsFile(roster, options);
+    mt19937 rng(18);
+    uniform_int_distribution<size_t> pick(0, roster.studentIds.size() - 1);
+    uniform_int_distribution<int> mark(0, 100);
+    size_t known = 0;
+    for (int i = 0; i < options.ops; ++i) {
+        // One call in ten inserts a student the snapshot does not have yet.
+        int studentId = i % 10 == 0 ? -1 - i : roster.studentIds[pick(rng)], attendance = mark(rng);
+        bool updated = false;
+        samples.micros.push_back(micros([&] {
+            WriterLock lock(datFilename);
+            AVLView view;
+            if (!lock.held() || !view.open(datFilename)) return;
+            known += view.contains(studentId);
+            updated = UpdateLog::append(datFilename, studentId, attendance, view.generation());
+            if (updated && UpdateLog::recordCount(datFilename) >= UpdateLog::compactionThreshold()) {
+                AVLTree tree;
+                updated = tree.deserialize(datFilename) && tree.serialize(datFilename);
+            }
+        }));
+        if (!updated) return false;
+    }
+    samples.items = options.ops;
+    return known > 0 || options.ops < 2;
+}
+
+static bool runThreshold(const Roster& roster, const Options& options, Samples& samples) {
+    const string datFilename = mathsFile(roster, options);
+    mt19937 rng(19);
+    uniform_int_distribution<int> mark(0, 100);
+    size_t listed = 0;
+    for (int i = 0; i < options.ops; ++i) {
+        int threshold = mark(rng), direction = i % 2 == 0 ? 1 : -1;
+        bool opened = false;
+        samples.micros.push_back(micros([&] {
+            AVLView view;
+            opened = view.open(datFilename);
+            if (opened) listed += view.getStudentIdsByThreshold(threshold, direction).size();
+        }));
+        if (!opened) return false;
+    }
+    samples.items = options.ops;
+    return listed > 0;
+}
+
+static bool runSearchTrie(const Roster& roster, const Options& options, Samples& samples) {
+    const string trieFilename = options.workDir + "/name.dat";
+    if (!TrieView::isFlat(trieFilename) && !buildTrie(roster, trieFilename)) return false;
+    mt19937 rng(20);
+    uniform_int_distribution<size_t> pick(0, roster.names.size() - 1);
+    size_t found = 0;
+    for (int i = 0; i < options.ops; ++i) {
+        const string& name = roster.names[pick(rng)];
+        const string prefix = name.substr(0, 1 + rng() % name.size());
+        bool opened = false;
+        samples.micros.push_back(micros([&] {
+            TrieView view;
+            opened = view.open(trieFilename);
+            if (opened) found += view.search(prefix).size();
+        }));
+        if (!opened) return false;
+    }
+    samples.items = options.ops;
+    return found > 0;
+}
+
+static bool runSearchTokens(const Roster& roster, const Options& options, Samples& samples) {
+    const string tokensFilename = tokenIndexFile(options.workDir + "/name.dat");
+    if (!TrieView::isFlat(tokensFilename) && !buildTokenIndexFile(roster, tokensFilename)) return false;
+    mt19937 rng(21);
+    uniform_int_distribution<size_t> pick(0, roster.names.size() - 1);
+    size_t found = 0;
+    for (int i = 0; i < options.ops; ++i) {
+        // Prefixes of two parts of one name, last part first ("Sh Aa")
+        vector<string> parts = nameTokens(roster.names[pick(rng)]);
+        string query;
+        for (size_t p = parts.size(); p-- > 0 && p + 2 >= parts.size();) {
+            query += parts[p].substr(0, 1 + rng() % parts[p].size()) + " ";
+        }
+        bool opened = false;
+        samples.micros.push_back(micros([&] {
+            TrieView view;
+            opened = view.open(tokensFilename);
+            if (opened) found += searchTokens(view, query).size();
+        }));
+        if (!opened) return false;
+    }
+    samples.items = options.ops;
+    return found > 0;
+}
+
+static double percentile(vector<double>& values, double p) {
+    size_t rank = static_cast<size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+    nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+static OpResult runOperation(const string& operation, const string& rosterFilename, const Options& options) {
+    OpResult result = {1, 0, 0, 0, 0};
+    Roster roster;
+    if (!loadRoster(rosterFilename, roster)) {
+        cerr << "Error reading the roster " << rosterFilename << endl;
+        return result;
+    }
+    Samples samples;
+    bool succeeded = operation == "create_avl"  ? runCreateAVL(roster, options, samples)
+                   : operation == "create_trie" ? runCreateTrie(roster, options, samples)
+                   : operation == "update_avl"  ? runUpdateAVL(roster, options, samples)
+                   : operation == "threshold"   ? runThreshold(roster, options, samples)
+                   : operation == "search_trie" ? runSearchTrie(roster, options, samples)
+                   : runSearchTokens(roster, options, samples);
+    if (!succeeded || samples.micros.empty()) {
+        cerr << operation << " failed in " << options.workDir << endl;
+        return result;
+    }
+    double totalUs = 0;
+    for (double us : samples.micros) totalUs += us;
+    result.failed = 0;
+    result.samples = samples.micros.size();
+    result.throughput = samples.items / (totalUs / 1e6);
+    result.p50Us = percentile(samples.micros, 50);
+    result.p99Us = percentile(samples.micros, 99);
+    return result;
+}
+
+// Runs the operation in a child process; peakRssKb is that child's high-water mark.
+static OpResult runIsolated(const string& operation, const string& rosterFilename, const Options& options,
+                            long& peakRssKb) {
+    OpResult result = {1, 0, 0, 0, 0};
+    int channel[2];
+    if (pipe(channel) != 0) return result;
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        close(channel[0]);
+        close(channel[1]);
+        return result;
+    }
+    if (child == 0) {
+        close(channel[0]);
+        OpResult measured = runOperation(operation, rosterFilename, options);
+        bool sent = write(channel[1], &measured, sizeof(measured)) == static_cast<ssize_t>(sizeof(measured));
+        _exit(sent ? 0 : 1);
+    }
+    close(channel[1]);
+    if (read(channel[0], &result, sizeof(result)) != static_cast<ssize_t>(sizeof(result))) result.failed = 1;
+    close(channel[0]);
+
+    int status;
+    struct rusage usage{};
+    if (wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) result.failed = 1;
+#ifdef __APPLE__
+    peakRssKb = usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    peakRssKb = usage.ru_maxrss;
+#endif
+    return result;
+}
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--ops N] [--repeat R] [--only op,...] [--json] [--work-dir dir] <roster_dir>" << endl;
+    cerr << "  roster_dir: holds attendance.csv (see gen_roster)" << endl;
+    cerr << "  --ops: calls per update_avl/threshold/search_trie/search_tokens run (default 1000)" << endl;
+    cerr << "  --repeat: builds per create_avl/create_trie run (default 3)" << endl;
+    cerr << "  --only: comma-separated subset of create_avl,create_trie,update_avl,threshold,search_trie," << endl;
+    cerr << "          search_tokens" << endl;
+    cerr << "  --json: one JSON object per operation instead of a table" << endl;
+    cerr << "  --work-dir: where the .dat files are written (default <roster_dir>/bench)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    vector<string> selected;
+    bool json = false, usageError = false;
+    string rosterDir;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string arg = argv[i];
+            if (arg == "--ops" && i + 1 < argc) options.ops = stoi(argv[++i]);
+            else if (arg == "--repeat" && i + 1 < argc) options.repeat = stoi(argv[++i]);
+            else if (arg == "--work-dir" && i + 1 < argc) options.workDir = argv[++i];
+            else if (arg == "--json") json = true;
+            else if (arg == "--only" && i + 1 < argc) {
+                string list = argv[++i];
+                for (size_t start = 0, comma; start <= list.size(); start = comma + 1) {
+                    comma = min(list.find(',', start), list.size());
+                    selected.push_back(list.substr(start, comma - start));
+                }
+            } else if (rosterDir.empty() && arg[0] != '-') {
+                rosterDir = arg;
+            } else {
+                usageError = true;
+            }
+        }
+    } catch (const exception&) {
+        usageError = true;
+    }
+    for (const auto& operation : selected) {
+        if (find(OPERATIONS.begin(), OPERATIONS.end(), operation) == OPERATIONS.end()) usageError = true;
+    }
+    if (usageError || rosterDir.empty() || options.ops < 1 || options.repeat < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (selected.empty()) selected = OPERATIONS;
+    if (options.workDir.empty()) options.workDir = rosterDir + "/bench";
+    mkdir(options.workDir.c_str(), 0755);
+
+    const string rosterFilename = rosterDir + "/attendance.csv";
+    if (!json) {
+        printf("%-12s %8s %12s %12s %20s %9s\n", "operation", "samples", "p50 us", "p99 us", "throughput", "peak RSS MB");
+    }
+    bool failed = false;
+    for (const auto& operation : OPERATIONS) {
+        if (find(selected.begin(), selected.end(), operation) == selected.end()) continue;
+        long peakRssKb = 0;
+        OpResult result = runIsolated(operation, rosterFilename, options, peakRssKb);
+        const char* unit = operation == "create_avl" ? "records/s" : operation == "create_trie" ? "names/s" : "calls/s";
+        if (result.failed) {
+            failed = true;
+            if (json) printf("{\"operation\":\"%s\",\"error\":\"failed\"}\n", operation.c_str());
+            else printf("%-12s failed\n", operation.c_str());
+        } else if (json) {
+            printf("{\"operation\":\"%s\",\"samples\":%llu,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+                   "\"throughput\":%.0f,\"unit\":\"%s\",\"peak_rss_kb\":%ld}\n",
+                   operation.c_str(), static_cast<unsigned long long>(result.samples), result.p50Us,
+                   result.p99Us, result.throughput, unit, peakRssKb);
+        } else {
+            printf("%-12s %8llu %12.1f %12.1f %10.0f %-9s %9.1f\n", operation.c_str(),
+                   static_cast<unsigned long long>(result.samples), result.p50Us, result.p99Us,
+                   result.throughput, unit, peakRssKb / 1024.0);
+        }
+        fflush(stdout);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#include "../avl.h"
+#include "legacy_avl.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+// Attendance update benchmark: side-indexed AVLTree::updateAttendance versus
+// the original full-tree scan in legacy::AVLTree, on identical workloads.
+//
+// Usage: ./bench_update [updates_per_size]
+
+struct Workload {
+    vector<pair<int, int>> roster;   // (attendance, studentId)
+    vector<pair<int, int>> updates;  // (studentId, newAttendance)
+};
+
+static Workload makeWorkload(int students, int updates, unsigned seed) {
+    mt19937 rng(seed);
+    uniform_int_distribution<int> attendance(0, 100);
+    uniform_int_distribution<int> pick(0, students - 1);
+
+    Workload workload;
+    workload.roster.reserve(students);
+    for (int i = 0; i < students; ++i) {
+        workload.roster.push_back({attendance(rng), 100000 + i});
+    }
+    for (int i = 0; i < updates; ++i) {
+        workload.updates.push_back({100000 + pick(rng), attendance(rng)});
+    }
+    return workload;
+}
+
+template <typename Tree>
+static double timeUpdates(Tree& tree, const vector<pair<int, int>>& updates, size_t count) {
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        tree.updateAttendance(updates[i].first, updates[i].second);
+    }
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+}
+
+int main(int argc, char* argv[]) {
+    int updates = argc > 1 ? stoi(argv[1]) : 2000;
+    const vector<int> sizes = {10000, 100000, 1000000};
+
+    cout << "students   indexed_us/op   legacy_us/op   speedup" << endl;
+    for (int students : sizes) {
+        Workload workload = makeWorkload(students, updates, 42);
+
+        AVLTree indexed;
+        legacy::AVLTree scanned;
+        for (const auto& [attendance, studentId] : workload.roster) {
+            indexed.insert(attendance, studentId);
+            scanned.insert(attendance, studentId);
+        }
+
+        // The scan is O(n) per update, so cap its sample to keep runs short.
+        size_t legacyCount = min<size_t>(updates, max(20, 20000000 / students));
+        double indexedUs = timeUpdates(indexed, workload.updates, updates);
+        double legacyUs = timeUpdates(scanned, workload.updates, legacyCount);
+
+        // Replay the rest on the legacy tree so both trees can be compared.
+        for (size_t i = legacyCount; i < workload.updates.size(); ++i) {
+            scanned.updateAttendance(workload.updates[i].first, workload.updates[i].second);
+        }
+        for (int key = 0; key <= 100; ++key) {
+            vector<int> expected = scanned.getStudentIdsByThreshold(key, 1);
+            vector<int> actual = indexed.getStudentIdsByThreshold(key, 1);
+            sort(expected.begin(), expected.end());
+            sort(actual.begin(), actual.end());
+            if (expected != actual) {
+                cerr << "Mismatch between indexed and legacy trees at " << students << " students" << endl;
+                return 1;
+            }
+        }
+
+        printf("%-10d %13.3f %14.3f %8.1fx\n", students, indexedUs, legacyUs, legacyUs / indexedUs);
+    }
+    return 0;
+}
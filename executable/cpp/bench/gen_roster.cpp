@@ -0,0 +1,167 @@
+#include "../columnar.h"
+#include "../face_matcher.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cmath>
+
+using namespace std;
+
+// Synthetic roster generator for benchmarks. Writes <output_dir>/students.csv
+// (student_id, name, rn, facial_vector) and <output_dir>/attendance.csv in
+// the same layout as executable/data, for any size from a classroom to 10M.
+//
+//   names       first and last names drawn with Zipf weights (s = 1), so a
+//               few names are very common and most are rare, as in real
+//               rosters; one student in four also gets a middle name
+//   IDs         distinct, in [100000, 100000 + students), in scrambled order
+//   attendance  per subject ~ N(80, 12) clamped to 0..100; total is the sum
+//   faces       FACE_EMBEDDING_DIM-d unit vectors, 4 decimals per value
+//
+// Faces dominate the output (about 1 KB per student); --no-faces leaves the
+// facial_vector column empty. The same seed always produces the same files.
+//
+// Usage: ./gen_roster [--students N] [--seed S] [--no-faces] <output_dir>
+
+static const vector<string> FIRST_NAMES = {
+    "Aarav", "Aarohi", "Vivaan", "Ananya", "Aditya", "Diya", "Vihaan", "Saanvi",
+    "Arjun", "Riya", "Sai", "Ishita", "Reyansh", "Kavya", "Ayaan", "Meera",
+    "Krishna", "Aadhya", "Ishaan", "Myra", "Shaurya", "Anika", "Atharv", "Pari",
+    "Advik", "Navya", "Pranav", "Tanvi", "Rohan", "Neha", "Dev", "Shanaya",
+    "Kabir", "Aarya", "Dhruv", "Kiara", "Tanmay", "Deeksha", "Rudra", "Tanisha",
+    "Aryan", "Devika", "Yash", "Shalini", "Vivek", "Riyaz", "Zara", "Farhan"
+};
+static const vector<string> LAST_NAMES = {
+    "Sharma", "Patel", "Singh", "Kumar", "Gupta", "Reddy", "Iyer", "Nair",
+    "Mehta", "Joshi", "Shah", "Verma", "Jain", "Yadav", "Mishra", "Das",
+    "Chatterjee", "Banerjee", "Kapoor", "Malhotra", "Saxena", "Tiwari", "Patil", "Deshmukh",
+    "Bhosale", "Kakkar", "Dubey", "Sood", "Bhat", "Rawat", "Saini", "Khan",
+    "Chopra", "Pillai", "Menon", "Agarwal", "Bose", "Sinha", "Kulkarni", "Rao"
+};
+
+static discrete_distribution<size_t> zipf(size_t count) {
+    vector<double> weights;
+    for (size_t rank = 1; rank <= count; ++rank) weights.push_back(1.0 / rank);
+    return discrete_distribution<size_t>(weights.begin(), weights.end());
+}
+
+// Appends value with exactly four decimals; printf is the bottleneck otherwise.
+static void appendFixed4(string& out, float value) {
+    if (value < 0) {
+        out += '-';
+        value = -value;
+    }
+    long scaled = lround(value * 10000.0f);
+    out += to_string(scaled / 10000);
+    char fraction[5] = {char('0' + scaled / 1000 % 10), char('0' + scaled / 100 % 10),
+                        char('0' + scaled / 10 % 10), char('0' + scaled % 10), '\0'};
+    out += '.';
+    out += fraction;
+}
+
+int main(int argc, char* argv[]) {
+    long students = 1000;
+    unsigned seed = 42;
+    bool faces = true;
+    bool usageError = false;
+    string outputDir;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string arg = argv[i];
+            if (arg == "--students" && i + 1 < argc) students = stol(argv[++i]);
+            else if (arg == "--seed" && i + 1 < argc) seed = static_cast<unsigned>(stoul(argv[++i]));
+            else if (arg == "--no-faces") faces = false;
+            else if (outputDir.empty() && arg[0] != '-') outputDir = arg;
+            else usageError = true;
+        }
+    } catch (const exception&) {
+        usageError = true;
+    }
+    if (usageError || outputDir.empty() || students < 1 || students > 100000000) {
+        cerr << "Usage: " << argv[0] << " [--students N] [--seed S] [--no-faces] <output_dir>" << endl;
+        cerr << "  --students: roster size, 1 to 100000000 (default 1000)" << endl;
+        cerr << "  --no-faces: leave facial_vector empty (faces are about 1 KB per student)" << endl;
+        return 1;
+    }
+
+    const string studentsFilename = outputDir + "/students.csv";
+    const string attendanceFilename = outputDir + "/attendance.csv";
+    FILE* studentsFile = fopen(studentsFilename.c_str(), "w");
+    FILE* attendanceFile = fopen(attendanceFilename.c_str(), "w");
+    if (!studentsFile || !attendanceFile) {
+        cerr << "Error creating " << studentsFilename << " and " << attendanceFilename << endl;
+        return 1;
+    }
+
+    mt19937_64 rng(seed);
+    discrete_distribution<size_t> firstName = zipf(FIRST_NAMES.size()), lastName = zipf(LAST_NAMES.size());
+    normal_distribution<float> mark(80.0f, 12.0f), component(0.0f, 1.0f);
+
+    // IDs come from a full-period LCG over the next power of two, skipping
+    // values past the roster: a cheap permutation that needs no table.
+    uint64_t period = 1;
+    while (period < static_cast<uint64_t>(students)) period <<= 1;
+    uint64_t state = seed % period;
+
+    string header = "student_id,name";
+    for (const auto& subject : attendanceSubjects()) header += "," + subject;
+    header += string(",") + TOTAL_COLUMN + "\n";
+    fputs("student_id,name,rn,facial_vector\n", studentsFile);
+    fputs(header.c_str(), attendanceFile);
+
+    string studentRow, attendanceRow;
+    vector<float> embedding(FACE_EMBEDDING_DIM);
+    for (long rn = 1; rn <= students; ++rn) {
+        do {
+            state = (state * 6364136223846793005ULL + 1442695040888963407ULL) & (period - 1);
+        } while (state >= static_cast<uint64_t>(students));
+        const string id = to_string(100000 + state);
+        const size_t first = firstName(rng);
+        string name = FIRST_NAMES[first] + " ";
+        if (rng() % 4 == 0) {
+            size_t middle;
+            do middle = firstName(rng); while (middle == first);
+            name += FIRST_NAMES[middle] + " ";
+        }
+        name += LAST_NAMES[lastName(rng)];
+
+        studentRow = id + "," + name + "," + to_string(rn) + ",";
+        if (faces) {
+            float norm = 0;
+            for (float& value : embedding) {
+                value = component(rng);
+                norm += value * value;
+            }
+            norm = sqrt(norm);
+            studentRow += '"';
+            for (size_t d = 0; d < embedding.size(); ++d) {
+                if (d > 0) studentRow += ',';
+                appendFixed4(studentRow, embedding[d] / norm);
+            }
+            studentRow += '"';
+        }
+        studentRow += '\n';
+        fwrite(studentRow.data(), 1, studentRow.size(), studentsFile);
+
+        attendanceRow = id + "," + name;
+        int total = 0;
+        for (size_t s = 0; s < attendanceSubjects().size(); ++s) {
+            int value = min(100, max(0, static_cast<int>(lround(mark(rng)))));
+            total += value;
+            attendanceRow += "," + to_string(value);
+        }
+        attendanceRow += "," + to_string(total) + "\n";
+        fwrite(attendanceRow.data(), 1, attendanceRow.size(), attendanceFile);
+    }
+
+    bool written = fclose(studentsFile) == 0;
+    written = fclose(attendanceFile) == 0 && written;
+    if (!written) {
+        cerr << "Error writing the roster to " << outputDir << endl;
+        return 1;
+    }
+    cout << "Wrote " << students << " students to " << studentsFilename << " and " << attendanceFilename << endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+#!/usr/bin/env bash
+# Profile-guided Release build of the tools.
+#
+# Builds instrumented tools (ATTENDANCE_PGO=GENERATE), runs them on a
+# synthetic roster from gen_roster the way server.py does: building every
+# subject index and the name trie (per tool and with build_all), threshold,
+# range and count queries on both index backends, single and batched updates,
+# prefix and fuzzy name searches, trie inserts, multi-column queries, face
+# matching, and a session of engine requests. It then rebuilds the same
+# directory with ATTENDANCE_PGO=USE. Install the result with
+# cmake --install <build_dir>.
+#
+# Usage: executable/cpp/bench/pgo.sh [build_dir] [students] [extra cmake args...]
+#   build_dir  default build-pgo in the repository root
+#   students   roster size for the training run (default 20000)
+# Example: executable/cpp/bench/pgo.sh build-pgo 50000 -DATTENDANCE_MARCH=x86-64-v3
+
+set -euo pipefail
+
+repo=$(cd "$(dirname "$0")/../../.." && pwd)
+build=$(realpath -m "${1:-$repo/build-pgo}")
+students=${2:-20000}
+shift $(( $# > 2 ? 2 : $# ))
+
+cmake -S "$repo" -B "$build" -DCMAKE_BUILD_TYPE=Release -DATTENDANCE_PGO=GENERATE "$@"
+profiles=$(sed -n 's/^ATTENDANCE_PGO_DIR:PATH=//p' "$build/CMakeCache.txt")
+cmake --build "$build" -j"$(nproc)"
+rm -rf "$profiles"
+mkdir -p "$profiles"
+
+work=$(mktemp -d)
+engine=""
+cleanup() {
+    if [ -n "$engine" ]; then kill "$engine" 2>/dev/null || true; fi
+    rm -rf "$work"
+}
+trap cleanup EXIT
+mkdir -p "$work/cpp" "$work/data" "$work/serialized"
+"$build/bench/gen_roster" --students "$students" --seed 7 "$work/data"
+cd "$work/cpp"
+
+echo "Training run on $students students in $work"
+subjects=$(head -1 ../data/attendance.csv | cut -d, -f3-)
+column=3
+for subject in ${subjects//,/ }; do
+    awk -F, -v c=$column 'NR > 1 { print $c, $1 }' ../data/attendance.csv | "$build/create_avl" "../serialized/$subject.dat" >/dev/null
+    column=$((column + 1))
+done
+awk -F, 'NR > 1 && NR <= 2001 { print $3, $1 }' ../data/attendance.csv | "$build/create_avl" --incremental ../serialized/incremental.dat >/dev/null
+"$build/create_trie" >/dev/null
+"$build/build_all" >/dev/null
+
+for threshold in $(seq 0 5 100); do
+    "$build/threshold" ../serialized/maths.dat "$threshold" 1 >/dev/null
+    "$build/threshold" ../serialized/physics.dat "$threshold" -1 >/dev/null
+    "$build/threshold" --index=bucket --count ../serialized/english.dat "$threshold" 1 >/dev/null
+    "$build/threshold" ../serialized/chemistry.dat --range "$threshold" $((threshold + 10)) >/dev/null
+done
+"$build/attendance_query" "maths<60" "physics<60" >/dev/null
+"$build/attendance_query" "total_attendance>=400" "english>90" >/dev/null
+"$build/attendance_query" --csv ../data/attendance.csv "datastructure<=50" >/dev/null
+
+ids=$(awk -F, 'NR > 1 && NR % 97 == 0 { print $1 }' ../data/attendance.csv | head -200)
+mark=0
+for id in $(echo "$ids" | head -40); do
+    "$build/update_avl" ../serialized/maths.dat $((mark % 101)) "$id" >/dev/null
+    mark=$((mark + 37))
+done
+for id in $ids; do echo "../serialized/english.dat $((RANDOM % 101)) $id"; done | "$build/update_avl" --batch >/dev/null
+for id in $ids; do echo "../serialized/physics.dat $((RANDOM % 101)) $id"; done | "$build/update_avl" --index=bucket --batch >/dev/null
+
+for prefix in A Aa Aarav Ar S Sh Sharma "Riya " K Kavya Z Zara Q; do
+    "$build/search_trie" "$prefix" >/dev/null || true
+    "$build/search_trie" "$prefix" --limit 20 >/dev/null || true
+    "$build/search_trie" "$prefix" --fuzzy auto --limit 20 >/dev/null || true
+    "$build/search_trie" "$prefix Sh" --match tokens >/dev/null || true
+done
+for n in $(seq 1 20); do "$build/insert_trie" "Trainee Student $n" $((900000 + n)) >/dev/null; done
+for n in $(seq 21 2000); do echo "Trainee Batch $n,$((900000 + n))"; done | "$build/insert_trie" --batch >/dev/null
+"$build/upgrade_dat" avl ../serialized/incremental.dat >/dev/null
+"$build/upgrade_dat" trie ../serialized/name.dat >/dev/null
+
+if command -v python3 >/dev/null; then
+    python3 - "$build/distance" <<'EOF'
+import random, struct, subprocess, sys
+random.seed(7)
+queries = b''.join(struct.pack('<128f', *[random.gauss(0, 0.09) for _ in range(128)]) for _ in range(200))
+subprocess.run([sys.argv[1], '--distances'], input=queries, stdout=subprocess.DEVNULL, check=True)
+EOF
+    "$build/hnsw_index" build ../serialized/faces.hnsw >/dev/null
+    "$build/hnsw_index" recall --queries 200 ../serialized/faces.hnsw >/dev/null
+
+    "$build/attendance_engine" "$work/engine.sock" ../serialized ../data/students.csv >/dev/null 2>&1 &
+    engine=$!
+    python3 - "$work/engine.sock" ../data/attendance.csv <<'EOF'
+import base64, random, socket, struct, sys, time
+for _ in range(200):
+    try:
+        conn = socket.socket(socket.AF_UNIX); conn.connect(sys.argv[1]); break
+    except OSError:
+        time.sleep(0.05)
+stream = conn.makefile('rw')
+def request(line):
+    stream.write(line + '\n'); stream.flush()
+    header = stream.readline().split()
+    for _ in range(int(header[1]) if header and header[0] == 'OK' else 0): stream.readline()
+random.seed(7)
+ids = [line.split(',')[0] for line in open(sys.argv[2]).readlines()[1:]]
+face = lambda: base64.b64encode(struct.pack('<128f', *[random.gauss(0, 0.09) for _ in range(128)])).decode()
+for n in range(2000):
+    subject = random.choice(['maths', 'english', 'chemistry', 'physics', 'datastructure'])
+    request(f"THRESHOLD {subject} {random.randint(0, 100)} {random.choice([1, -1])}")
+    request(f"RANGE {subject} {random.randint(0, 90)} {random.randint(90, 100)}")
+    request(f"UPDATE {subject} {random.randint(0, 100)} {random.choice(ids)}")
+    request(f"SEARCH {random.choice(['A', 'Ar', 'S', 'Sh', 'K', 'Riya', 'Z'])}")
+    if n % 10 == 0:
+        request(f"WHERE maths<{random.randint(40, 80)} physics<{random.randint(40, 80)}")
+        request(f"SEARCHPAGE 20 - {random.choice(['A', 'S', 'K'])}")
+        request(f"SEARCHTOKENS {random.choice(['Aa Sh', 'Sharma', 'K', 'Riya Si', 'a s'])}")
+        request(f"FUZZY 20 - {random.choice(['Arav Mehta', 'Shrma', 'Kavia', 'Riya Sing', 'Zra'])}")
+        request(f"UPDATEBATCH {subject} " + ' '.join(f"{random.randint(0, 100)}:{random.choice(ids)}" for _ in range(50)))
+        request(f"INSERT {990000 + n} Engine Trainee {n}")
+        request(f"MATCH {face()}")
+request('SAVE')
+EOF
+    kill "$engine"
+    wait "$engine" || true
+    engine=""
+fi
+
+cd "$repo"
+if compgen -G "$profiles/*.profraw" >/dev/null; then  # clang: merge the raw profiles
+    llvm-profdata merge -o "$profiles/merged.profdata" "$profiles"/*.profraw
+fi
+cmake -S "$repo" -B "$build" -DATTENDANCE_PGO=USE
+cmake --build "$build" -j"$(nproc)"
+echo "Profile-guided build ready in $build (install with: cmake --install $build)"
@@ -0,0 +1,208 @@
+#include "../columnar.h"
+#include "../versioned.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <unistd.h>
+
+using namespace std;
+
+// Concurrent readers against a single writer, at both levels the engine and
+// the tools share data:
+//   memory  Versioned<ColumnarStore>: each write moves a student's maths and
+//           english marks so that they still sum to 100 and bumps a sentinel
+//           student by one; readers check that invariant, that every index
+//           agrees with its column, and that the sentinel never goes back.
+//   files   one writer appends to a .dat update log under its WriterLock and
+//           compacts it every 64 appends, while readers repeatedly map it
+//           (AVLView) or load it (AVLTree) and check that every student is
+//           present exactly once and the sentinel never goes back.
+// Exits with 1 on the first inconsistency.
+//
+// Usage: ./stress_concurrency [readers] [writes] [students]
+
+static const int SENTINEL = 0;
+static const int SENTINEL_BASE = 1000;
+
+static atomic<bool> failed(false);
+
+static void fail(const string& message) {
+    if (!failed.exchange(true)) cerr << "Inconsistent read: " << message << endl;
+}
+
+template <typename Function>
+static double seconds(Function&& function) {
+    auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void stressMemory(int readers, int writes, int students) {
+    const vector<string> subjects = {"maths", "english"};
+    ColumnarStore initial(subjects);
+    initial.set(0, SENTINEL, SENTINEL_BASE);
+    initial.set(1, SENTINEL, 100 - SENTINEL_BASE);
+    for (int id = 1; id <= students; ++id) {
+        initial.set(0, id, id % 101);
+        initial.set(1, id, 100 - id % 101);
+    }
+    Versioned<ColumnarStore> attendance(initial);
+
+    atomic<bool> writing(true);
+    atomic<long> reads(0);
+    vector<thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            mt19937 rng(r);
+            uniform_int_distribution<int> pick(1, students);
+            int lastSentinel = INT_MIN;
+            long done = 0;
+            while (writing && !failed) {
+                auto store = attendance.read();
+                int sentinel = store->value(0, SENTINEL);
+                if (sentinel < lastSentinel) fail("sentinel went back from " + to_string(lastSentinel));
+                lastSentinel = sentinel;
+                for (int i = 0; i < 32; ++i) {
+                    int id = pick(rng), maths = store->value(0, id), english = store->value(1, id), indexed;
+                    if (maths + english != 100 || store->value(store->totalColumn(), id) != 100) {
+                        fail("student " + to_string(id) + " marks do not sum to 100");
+                    }
+                    if (!store->index(0).attendanceOf(id, indexed) || indexed != maths) {
+                        fail("maths index disagrees with its column for " + to_string(id));
+                    }
+                }
+                if (store->index(store->totalColumn()).countInRange(100, 100) != static_cast<size_t>(students) + 1) {
+                    fail("total_attendance index lost a student");
+                }
+                ++done;
+            }
+            reads += done;
+        });
+    }
+
+    mt19937 rng(12345);
+    uniform_int_distribution<int> pick(1, students), mark(0, 100);
+    double elapsed = seconds([&] {
+        for (int w = 1; w <= writes && !failed; ++w) {
+            int id = pick(rng), maths = mark(rng);
+            attendance.write([id, maths, w](ColumnarStore& store) {
+                store.set(0, id, maths);
+                store.set(1, id, 100 - maths);
+                store.set(0, SENTINEL, SENTINEL_BASE + w);
+                store.set(1, SENTINEL, 100 - SENTINEL_BASE - w);
+            });
+        }
+    });
+    writing = false;
+    for (auto& t : threads) t.join();
+    printf("%-7s %8d writes %10.0f writes/s %10ld reads %12.0f reads/s\n", "memory",
+           writes, writes / elapsed, reads.load(), reads / elapsed);
+}
+
+static void stressFiles(int readers, int writes, int students, const string& datFilename) {
+    AVLTree mirror;
+    mirror.updateAttendance(SENTINEL, SENTINEL_BASE);
+    for (int id = 1; id <= students; ++id) mirror.updateAttendance(id, id % 101);
+    {
+        WriterLock lock(datFilename);
+        UpdateLog::remove(datFilename);
+        if (!mirror.serialize(datFilename)) {
+            fail("cannot write " + datFilename);
+            return;
+        }
+    }
+
+    atomic<bool> writing(true);
+    atomic<long> reads(0);
+    vector<thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            int lastSentinel = INT_MIN;
+            long done = 0;
+            while (writing && !failed) {
+                int sentinel;
+                if (r % 2 == 0) {
+                    AVLView view;
+                    if (!view.open(datFilename)) {
+                        fail("cannot map " + datFilename);
+                        break;
+                    }
+                    if (view.getStudentIdsInRange(INT_MIN, INT_MAX).size() != static_cast<size_t>(students) + 1) {
+                        fail("mapped snapshot plus log does not hold every student once");
+                    }
+                    vector<int> top = view.getStudentIdsInRange(SENTINEL_BASE, INT_MAX);
+                    if (top.size() != 1 || top[0] != SENTINEL) fail("sentinel missing from the mapped view");
+                    int lo = SENTINEL_BASE, hi = INT_MAX;
+                    while (lo < hi) {  // the sentinel's value, by bisection on the view
+                        int mid = lo + (hi - lo + 1) / 2;
+                        if (view.getStudentIdsInRange(mid, INT_MAX).empty()) hi = mid - 1;
+                        else lo = mid;
+                    }
+                    sentinel = lo;
+                } else {
+                    AVLTree tree;
+                    if (!tree.deserialize(datFilename) || tree.size() != static_cast<size_t>(students) + 1 ||
+                        !tree.attendanceOf(SENTINEL, sentinel)) {
+                        fail("loaded tree does not hold every student once");
+                        break;
+                    }
+                }
+                if (sentinel < lastSentinel) {
+                    fail("sentinel went back from " + to_string(lastSentinel) + " to " + to_string(sentinel));
+                }
+                lastSentinel = sentinel;
+                ++done;
+            }
+            reads += done;
+        });
+    }
+
+    mt19937 rng(54321);
+    uniform_int_distribution<int> pick(1, students), mark(0, 100);
+    double elapsed = seconds([&] {
+        for (int w = 1; w <= writes && !failed; ++w) {
+            int id = pick(rng), attendance = mark(rng);
+            mirror.updateAttendance(id, attendance);
+            mirror.updateAttendance(SENTINEL, SENTINEL_BASE + w);
+            WriterLock lock(datFilename);
+            bool written = w % 64 == 0
+                ? mirror.serialize(datFilename)
+                : UpdateLog::append(datFilename, {UpdateLog::makeRecord(id, attendance),
+                                                  UpdateLog::makeRecord(SENTINEL, SENTINEL_BASE + w)},
+                                    AVLView::readGeneration(datFilename));
+            if (!written) fail("write " + to_string(w) + " failed");
+        }
+    });
+    writing = false;
+    for (auto& t : threads) t.join();
+    printf("%-7s %8d writes %10.0f writes/s %10ld reads %12.0f reads/s\n", "files",
+           writes, writes / elapsed, reads.load(), reads / elapsed);
+
+    UpdateLog::remove(datFilename);
+    unlink(datFilename.c_str());
+    unlink((datFilename + ".lock").c_str());
+}
+
+int main(int argc, char* argv[]) {
+    int readers = argc > 1 ? stoi(argv[1]) : 8;
+    int writes = argc > 2 ? stoi(argv[2]) : 1000;
+    int students = argc > 3 ? stoi(argv[3]) : 10000;
+    if (readers < 1 || writes < 1 || students < 1) {
+        cerr << "Usage: " << argv[0] << " [readers] [writes] [students]" << endl;
+        return 1;
+    }
+
+    stressMemory(readers, writes, students);
+    const char* tmp = getenv("TMPDIR");
+    stressFiles(readers, writes, students, string(tmp ? tmp : "/tmp") + "/stress_concurrency_" + to_string(getpid()) + ".dat");
+
+    if (failed) return 1;
+    printf("No inconsistent reads with %d readers.\n", readers);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env bash
+# Stress test for tools and the engine writing the same snapshot files.
+#
+# Builds a synthetic roster, starts attendance_engine on it and, at the same
+# time, sends engine UPDATE, UPDATEBATCH and SAVE requests for one half of the
+# students while update_avl (single and --batch) updates the other half of the
+# same maths.dat. A small ATTENDANCE_WAL_MAX_RECORDS makes both sides compact
+# the file often. Finally the engine saves and reloads from disk, and every
+# student's maths attendance must be the last value either side wrote.
+# Exits with 1 on the first lost or wrong update.
+#
+# Usage: executable/cpp/bench/stress_engine_tools.sh [build_dir] [rounds] [students]
+#   build_dir  default build in the repository root
+#   rounds     update rounds on each side (default 300)
+#   students   roster size (default 5000)
+
+set -euo pipefail
+
+repo=$(cd "$(dirname "$0")/../../.." && pwd)
+build=$(realpath -m "${1:-$repo/build}")
+rounds=${2:-300}
+students=${3:-5000}
+
+work=$(mktemp -d)
+engine=""
+cleanup() {
+    if [ -n "$engine" ]; then kill "$engine" 2>/dev/null || true; fi
+    rm -rf "$work"
+}
+trap cleanup EXIT
+mkdir -p "$work/cpp" "$work/data" "$work/serialized"
+"$build/bench/gen_roster" --students "$students" --seed 11 "$work/data" >/dev/null
+cd "$work/cpp"
+"$build/build_all" >/dev/null
+
+export ATTENDANCE_WAL_MAX_RECORDS=32
+"$build/attendance_engine" "$work/engine.sock" ../serialized ../data/students.csv >/dev/null 2>&1 &
+engine=$!
+python3 - "$work/engine.sock" ../data/attendance.csv "$build/update_avl" "$rounds" <<'EOF'
+import random, socket, subprocess, sys, threading, time
+sock, roster, update_avl, rounds = sys.argv[1], sys.argv[2], sys.argv[3], int(sys.argv[4])
+for _ in range(200):
+    try:
+        conn = socket.socket(socket.AF_UNIX); conn.connect(sock); break
+    except OSError:
+        time.sleep(0.05)
+stream = conn.makefile('rw')
+def request(line):
+    stream.write(line + '\n'); stream.flush()
+    header = stream.readline().split()
+    lines = [stream.readline().strip() for _ in range(int(header[1]) if header and header[0] == 'OK' else 0)]
+    if not header or header[0] != 'OK': sys.exit(f"engine refused {line[:60]}: {' '.join(header)}")
+    return lines
+
+ids = [int(line.split(',')[0]) for line in open(roster).readlines()[1:]]
+engineIds, toolIds = ids[0::2], ids[1::2]
+expected = {}
+
+def tools():
+    rng = random.Random(2)
+    for n in range(rounds):
+        if n % 10 == 0:
+            batch = {rng.choice(toolIds): rng.randint(0, 100) for _ in range(20)}
+            lines = ''.join(f"../serialized/maths.dat {v} {i}\n" for i, v in batch.items())
+            subprocess.run([update_avl, '--batch'], input=lines.encode(), stdout=subprocess.DEVNULL, check=True)
+            expected.update(batch)
+        else:
+            i, v = rng.choice(toolIds), rng.randint(0, 100)
+            subprocess.run([update_avl, '../serialized/maths.dat', str(v), str(i)], stdout=subprocess.DEVNULL, check=True)
+            expected[i] = v
+
+writer = threading.Thread(target=tools)
+writer.start()
+rng = random.Random(1)
+for n in range(rounds):
+    if n % 10 == 0:
+        batch = {rng.choice(engineIds): rng.randint(0, 100) for _ in range(20)}
+        request("UPDATEBATCH maths " + ' '.join(f"{v}:{i}" for i, v in batch.items()))
+        expected.update(batch)
+    else:
+        i, v = rng.choice(engineIds), rng.randint(0, 100)
+        request(f"UPDATE maths {v} {i}")
+        expected[i] = v
+    if n % 25 == 0: request('SAVE')
+writer.join()
+request('SAVE')
+request('RELOAD')
+
+wrong = 0
+for value in range(101):
+    stored = set(map(int, request(f"RANGE maths {value} {value}")))
+    for i, v in expected.items():
+        if v == value and i not in stored:
+            wrong += 1
+            if wrong <= 5: print(f"student {i}: expected maths {v}", file=sys.stderr)
+if wrong:
+    sys.exit(f"{wrong} of {len(expected)} updated students lost their last update")
+print(f"All {len(expected)} updated students kept their last update across {rounds} rounds per side.")
+EOF
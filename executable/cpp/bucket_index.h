@@ -0,0 +1,246 @@
+#pragma once
+#include "avl.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// Counting index for small, non-negative attendance domains (0..100 per
+// subject, a few hundred for total_attendance), where a balanced BST is
+// mostly pointer chasing. Each attendance value owns one bucket of student
+// IDs, a Fenwick tree over the bucket sizes answers "how many at or below v"
+// in O(log V), and a bitmap of non-empty buckets lets enumeration skip empty
+// values 64 at a time, so listing k students costs O(k + V/64).
+//
+// Buckets are compressed sorted ID lists (posting_list.h), so an update is
+// an O(log n) erase from the old bucket, an O(log n) insert into the new one
+// and two O(log V) Fenwick adjustments. Snapshots use the same flat .dat
+// format and update log as AVLTree, so the two are interchangeable.
+class BucketIndex {
+public:
+    // Largest attendance the index accepts (buckets grow on demand up to it).
+    static constexpr int MAX_ATTENDANCE = (1 << 20) - 1;
+
+    static bool accepts(int attendance) {
+        return attendance >= 0 && attendance <= MAX_ATTENDANCE;
+    }
+
+private:
+    vector<PostingList> buckets;   // buckets[v]: students with attendance v
+    vector<uint32_t> fenwick;      // 1-based Fenwick tree over bucket sizes
+    vector<uint64_t> occupied;     // bit v set while buckets[v] is non-empty
+    unordered_map<int, int> idIndex;  // studentId -> attendance
+    uint32_t logGeneration;
+
+    int capacity() const {
+        return static_cast<int>(buckets.size());
+    }
+
+    // Widens the domain to a power of two above attendance; O(V) but only
+    // happens when a value beyond every earlier one shows up.
+    void grow(int attendance) {
+        int newCapacity = max(capacity(), 128);
+        while (newCapacity <= attendance) newCapacity *= 2;
+        if (newCapacity == capacity()) return;
+        buckets.resize(newCapacity);
+        occupied.resize(newCapacity / 64, 0);
+        fenwick.assign(newCapacity + 1, 0);
+        for (int v = 0; v < newCapacity; ++v) {
+            fenwick[v + 1] += static_cast<uint32_t>(buckets[v].size());
+            int parent = (v + 1) + ((v + 1) & -(v + 1));
+            if (parent <= newCapacity) fenwick[parent] += fenwick[v + 1];
+        }
+    }
+
+    void addCount(int attendance, int delta) {
+        for (int i = attendance + 1; i <= capacity(); i += i & -i) fenwick[i] += delta;
+    }
+
+    // Number of students with attendance <= v (v clamped to the domain)
+    uint32_t countUpTo(int v) const {
+        if (v < 0) return 0;
+        uint32_t count = 0;
+        for (int i = min(v, capacity() - 1) + 1; i > 0; i -= i & -i) count += fenwick[i];
+        return count;
+    }
+
+    void place(int attendance, int studentId) {
+        if (attendance >= capacity()) grow(attendance);
+        idIndex[studentId] = attendance;
+        buckets[attendance].insert(studentId);
+        occupied[attendance / 64] |= uint64_t(1) << (attendance % 64);
+        addCount(attendance, 1);
+    }
+
+    bool removeStudentId(int studentId) {
+        auto located = idIndex.find(studentId);
+        if (located == idIndex.end()) return false;
+        int attendance = located->second;
+        idIndex.erase(located);
+
+        PostingList& bucket = buckets[attendance];
+        bucket.erase(studentId);
+        if (bucket.empty()) occupied[attendance / 64] &= ~(uint64_t(1) << (attendance % 64));
+        addCount(attendance, -1);
+        return true;
+    }
+
+    // Highest non-empty bucket at or below v, or -1
+    int occupiedAtMost(int v) const {
+        if (v < 0 || capacity() == 0) return -1;
+        v = min(v, capacity() - 1);
+        int word = v / 64;
+        uint64_t bits = occupied[word] & (~uint64_t(0) >> (63 - v % 64));
+        while (bits == 0) {
+            if (--word < 0) return -1;
+            bits = occupied[word];
+        }
+        return word * 64 + 63 - __builtin_clzll(bits);
+    }
+
+    void clear() {
+        buckets.clear();
+        fenwick.assign(1, 0);
+        occupied.clear();
+        idIndex.clear();
+        logGeneration = 0;
+    }
+
+public:
+    BucketIndex() : fenwick(1, 0), logGeneration(0) {}
+
+    size_t size() const {
+        return idIndex.size();
+    }
+
+    uint32_t generation() const {
+        return logGeneration;
+    }
+
+    // Same contract as AVLTree::updateAttendance; attendance must satisfy accepts().
+    bool updateAttendance(int studentId, int newAttendance) {
+        ScopedTimer timer(Phase::Update);
+        bool studentFound = removeStudentId(studentId);
+        place(newAttendance, studentId);
+        return studentFound;
+    }
+
+    // IDs with lo <= attendance <= hi, highest attendance first and
+    // ascending by ID within an attendance
+    vector<int> getStudentIdsInRange(int lo, int hi) const {
+        ScopedTimer timer(Phase::Query);
+        vector<int> result;
+        if (lo > hi || hi < 0) return result;
+        result.reserve(countInRange(lo, hi));
+        for (int v = occupiedAtMost(hi); v >= 0 && v >= lo; v = occupiedAtMost(v - 1)) {
+            buckets[v].appendTo(result);
+        }
+        return result;
+    }
+
+    // direction > 0: attendance >= threshold, direction < 0: attendance <= threshold
+    vector<int> getStudentIdsByThreshold(int threshold, int direction) const {
+        if (direction > 0) return getStudentIdsInRange(threshold, INT_MAX);
+        return getStudentIdsInRange(INT_MIN, threshold);
+    }
+
+    // Number of students with lo <= attendance <= hi, in O(log V)
+    size_t countInRange(int lo, int hi) const {
+        if (lo > hi || hi < 0) return 0;
+        return countUpTo(hi) - (lo > 0 ? countUpTo(lo - 1) : 0);
+    }
+
+    size_t countByThreshold(int threshold, int direction) const {
+        if (direction > 0) return countInRange(threshold, INT_MAX);
+        return countInRange(INT_MIN, threshold);
+    }
+
+    bool serialize(const string& filename) {
+        ScopedTimer timer(Phase::Serialize);
+        vector<FlatAVLKey> keys;
+        vector<int32_t> ids;
+        ids.reserve(idIndex.size());
+        for (int v = 0; v < capacity(); ++v) {
+            if (buckets[v].empty()) continue;
+            keys.push_back({v, static_cast<uint32_t>(ids.size()), static_cast<uint32_t>(buckets[v].size())});
+            buckets[v].appendTo(ids);
+        }
+        return writeFlatAVL(filename, keys, ids, logGeneration);
+    }
+
+    // Loads a flat or legacy snapshot and replays its update log, like
+    // AVLTree::deserialize (including the reload after a concurrent
+    // compaction). Fails as well if any value is outside accepts().
+    bool deserialize(const string& filename) {
+        ScopedTimer timer(Phase::Deserialize);
+        for (int attempt = 1;; ++attempt) {
+            if (!deserializeOnce(filename)) return false;
+            if (!AVLView::isFlat(filename) || AVLView::readGeneration(filename) == logGeneration) return true;
+            if (attempt == 8) return false;  // still racing compactions
+        }
+    }
+
+private:
+    bool deserializeOnce(const string& filename) {
+        clear();
+        if (!AVLView::isFlat(filename)) {
+            AVLTree tree;
+            if (!tree.deserialize(filename)) return false;
+            bool valid = true;
+            tree.forEach([&](int attendance, int studentId) {
+                if (!accepts(attendance)) valid = false;
+                else if (!idIndex.count(studentId)) place(attendance, studentId);
+            });
+            logGeneration = tree.generation();
+            return valid;
+        }
+
+        AVLView view;
+        if (!view.open(filename, false)) return false;
+        if (view.size() > 0) {
+            const FlatAVLKey& highest = view.key(view.size() - 1);
+            if (!accepts(view.key(0).attendance) || !accepts(highest.attendance)) return false;
+            grow(highest.attendance);
+            idIndex.reserve(highest.idBegin + highest.idCount);
+        }
+        vector<int> ids;
+        for (uint32_t i = 0; i < view.size(); ++i) {
+            const FlatAVLKey& entry = view.key(i);
+            ids.clear();
+            view.appendIdsOf(entry, ids);
+            for (int studentId : ids) {
+                if (!idIndex.count(studentId)) place(entry.attendance, studentId);
+            }
+        }
+        logGeneration = view.generation();
+
+        for (const UpdateRecord& record : UpdateLog::read(filename, logGeneration)) {
+            if (!accepts(record.attendance)) return false;
+            updateAttendance(record.studentId, record.attendance);
+        }
+        return true;
+    }
+};
+
+// Strips a "--index=avl|bucket" argument, wherever it appears, for the tools
+// that can run on either backend. Returns false for an unknown backend.
+inline bool takeIndexFlag(int& argc, char* argv[], bool& useBuckets) {
+    useBuckets = false;
+    int kept = 1;
+    bool valid = true;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--index=", 8) != 0) {
+            argv[kept++] = argv[i];
+            continue;
+        }
+        if (strcmp(arg + 8, "bucket") == 0) useBuckets = true;
+        else if (strcmp(arg + 8, "avl") != 0) valid = false;
+    }
+    argc = kept;
+    return valid;
+}
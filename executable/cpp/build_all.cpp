@@ -0,0 +1,225 @@
+#include "columnar.h"
+#include "token_index.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+// Startup build of every index in one process: the AVL snapshot of each
+// attendance column (<column>.dat, total_attendance derived from the subjects
+// where the CSV has no total) from attendance.csv, and the name Trie
+// (name.dat) and its token index (name_tokens.dat, see token_index.h) from
+// students.csv. Each CSV is parsed once (csv_reader.h) and the parsed rows
+// are shared by every index built from it. This replaces one create_avl run
+// per column plus a create_trie run, each of which re-parsed its input.
+//
+// The work runs on a pool of threads. The attendance and names parses start
+// together. Once the attendance parse is done, each column's index becomes a
+// task of its own; once the names parse is done, so do the trie and the
+// token index. Every file is written as soon as its index is
+// built. One line per index reports the time it took (build and write), and
+// a final line gives the wall time.
+//
+// Usage: ./build_all [--threads N] [--data <dir>] [--serialized <dir>]
+//   --threads:    worker threads (default one per core)
+//   --data:       directory with students.csv and attendance.csv (default ../data)
+//   --serialized: directory the .dat files are written to (default ../serialized)
+
+// Runs queued tasks on a fixed set of threads. Tasks may queue more tasks;
+// wait() returns once the queue is empty and no task is running.
+class TaskPool {
+private:
+    mutex lock;
+    condition_variable changed;
+    deque<function<void()>> queue;
+    size_t running;
+    bool stopping;
+    vector<thread> workers;
+
+    void work() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            changed.wait(guard, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            function<void()> task = move(queue.front());
+            queue.pop_front();
+            ++running;
+            guard.unlock();
+            task();
+            guard.lock();
+            --running;
+            changed.notify_all();
+        }
+    }
+
+public:
+    explicit TaskPool(size_t threads) : running(0), stopping(false) {
+        for (size_t t = 0; t < threads; ++t) workers.emplace_back([this] { work(); });
+    }
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+    ~TaskPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> guard(lock);
+            queue.push_back(move(task));
+        }
+        changed.notify_all();
+    }
+
+    void wait() {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] { return queue.empty() && running == 0; });
+    }
+};
+
+static double millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// "12.3 ms"
+static string millis(double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f ms", value);
+    return text;
+}
+
+int main(int argc, char* argv[]) {
+    MetricsReport metrics("build_all", argc, argv);
+    string dataDir = "../data", serializedDir = "../serialized";
+    size_t threads = max<size_t>(thread::hardware_concurrency(), 1);
+    bool usageError = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string arg = argv[i];
+            if (arg == "--data" && i + 1 < argc) dataDir = argv[++i];
+            else if (arg == "--serialized" && i + 1 < argc) serializedDir = argv[++i];
+            else if (arg == "--threads" && i + 1 < argc) threads = stoul(argv[++i]);
+            else usageError = true;
+        }
+    } catch (const exception&) {
+        usageError = true;
+    }
+    if (usageError || threads < 1) {
+        cerr << "Usage: " << argv[0] << " [--threads N] [--data <dir>] [--serialized <dir>]" << endl;
+        return 1;
+    }
+
+    const auto started = chrono::steady_clock::now();
+    mutex outputLock;
+    atomic<bool> failed(false);
+    auto report = [&](const string& message, bool error) {
+        lock_guard<mutex> guard(outputLock);
+        (error ? cerr : cout) << message << endl;
+        if (error) failed = true;
+    };
+
+    ColumnarStore store;
+    TaskPool pool(threads);
+
+    // The attendance parse fans out into one task per column
+    pool.submit([&] {
+        const string attendanceFilename = dataDir + "/attendance.csv";
+        auto parseStart = chrono::steady_clock::now();
+        if (!store.readCSV(attendanceFilename)) {
+            report("Error reading " + attendanceFilename, true);
+            return;
+        }
+        report("Parsed " + attendanceFilename + " (" + to_string(store.studentCount()) + " students) in " +
+               millis(millisSince(parseStart)), false);
+        for (size_t c = 0; c < store.columnCount(); ++c) {
+            pool.submit([&, c] {
+                auto buildStart = chrono::steady_clock::now();
+                store.buildIndex(c);
+                const double buildMillis = millisSince(buildStart);
+
+                // Under the writer lock, as in create_avl: a concurrent
+                // update_avl cannot append to the log being replaced
+                auto writeStart = chrono::steady_clock::now();
+                const string datFilename = store.snapshotFile(serializedDir, c);
+                WriterLock lock(datFilename);
+                if (!lock.held() || !store.index(c).serialize(datFilename)) {
+                    report("Error: Failed to serialize AVL tree to " + datFilename, true);
+                    return;
+                }
+                const double writeMillis = millisSince(writeStart);
+                report("Built " + datFilename + " (" + to_string(store.index(c).size()) + " students) in " +
+                       millis(buildMillis + writeMillis) + " (build " + millis(buildMillis) + ", write " +
+                       millis(writeMillis) + ")", false);
+            });
+        }
+    });
+
+    // The names parse fans out into the trie and its token index. Both
+    // read the same records, which point into the mapped students.csv.
+    CSVReader studentsCsv;
+    vector<pair<int, string_view>> names;
+    pool.submit([&] {
+        const string studentsFilename = dataDir + "/students.csv";
+        auto parseStart = chrono::steady_clock::now();
+        if (!studentsCsv.open(studentsFilename)) {
+            report("Error opening CSV file: " + studentsFilename, true);
+            return;
+        }
+        readStudentNames(studentsCsv, names);
+        report("Parsed " + studentsFilename + " (" + to_string(names.size()) + " names) in " +
+               millis(millisSince(parseStart)), false);
+
+        pool.submit([&] {
+            const string trieFilename = serializedDir + "/name.dat";
+            auto buildStart = chrono::steady_clock::now();
+            Trie trie;
+            for (const auto& [studentId, name] : names) trie.insert(string(name), studentId);
+            const double buildMillis = millisSince(buildStart);
+
+            auto writeStart = chrono::steady_clock::now();
+            if (!trie.serialize(trieFilename)) {
+                report("Failed to serialize the trie to " + trieFilename, true);
+                return;
+            }
+            const double writeMillis = millisSince(writeStart);
+            report("Built " + trieFilename + " (" + to_string(names.size()) + " names) in " +
+                   millis(buildMillis + writeMillis) + " (build " + millis(buildMillis) + ", write " +
+                   millis(writeMillis) + ")", false);
+        });
+
+        pool.submit([&] {
+            const string tokensFilename = tokenIndexFile(serializedDir + "/name.dat");
+            auto buildStart = chrono::steady_clock::now();
+            Trie tokens;
+            for (const auto& [studentId, name] : names) insertNameTokens(tokens, name, studentId);
+            const double buildMillis = millisSince(buildStart);
+
+            auto writeStart = chrono::steady_clock::now();
+            if (!tokens.serialize(tokensFilename)) {
+                report("Failed to serialize the token index to " + tokensFilename, true);
+                return;
+            }
+            const double writeMillis = millisSince(writeStart);
+            report("Built " + tokensFilename + " (" + to_string(names.size()) + " names) in " +
+                   millis(buildMillis + writeMillis) + " (build " + millis(buildMillis) + ", write " +
+                   millis(writeMillis) + ")", false);
+        });
+    });
+
+    pool.wait();
+    report("All indexes built in " + millis(millisSince(started)) + " on " + to_string(threads) + " threads", false);
+    return failed ? 1 : 0;
+}
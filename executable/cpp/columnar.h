@@ -0,0 +1,244 @@
+#pragma once
+#include "avl.h"
+#include "csv_reader.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <climits>
+#include <cstdint>
+
+using namespace std;
+
+// Column-oriented attendance store. Every student gets a dense ordinal on
+// first sight and each subject is one int array indexed by that ordinal, so
+// reading or marking a student touches one slot per column instead of one
+// tree node per subject. total_attendance is kept as a column of its own and
+// moved by the same delta as every subject update, instead of being written
+// as a separate, independently updated tree.
+//
+// Each column also keeps an AVLTree over its values for threshold and range
+// queries. Those trees are what gets persisted (<dir>/<column>.dat plus its
+// update log), so the snapshots stay readable by threshold, update_avl and
+// the other tools.
+
+inline const char* const TOTAL_COLUMN = "total_attendance";
+
+inline const vector<string>& attendanceSubjects() {
+    static const vector<string> subjects = {"maths", "english", "chemistry", "physics", "datastructure"};
+    return subjects;
+}
+
+// One query condition: lo <= value of column <= hi
+struct ColumnRange {
+    size_t column;
+    int lo;
+    int hi;
+};
+
+class ColumnarStore {
+public:
+    // Value of a subject the student has no record for; never matches a query.
+    static constexpr int MISSING = INT_MIN;
+
+private:
+    vector<string> names;             // subject columns, then total_attendance
+    vector<int> studentIds;           // ordinal -> student ID
+    unordered_map<int, uint32_t> ordinals;
+    vector<vector<int>> columns;      // columns[c][ordinal]
+    vector<AVLTree> indexes;          // indexes[c] holds every non-missing value of columns[c]
+
+    uint32_t ordinalFor(int studentId) {
+        auto found = ordinals.find(studentId);
+        if (found != ordinals.end()) return found->second;
+        uint32_t ordinal = static_cast<uint32_t>(studentIds.size());
+        ordinals.emplace(studentId, ordinal);
+        studentIds.push_back(studentId);
+        for (auto& column : columns) column.push_back(MISSING);
+        return ordinal;
+    }
+
+    // Gives every student without a stored total the sum of their subjects,
+    // in the total column and, when indexed, in its index.
+    void deriveMissingTotals(bool indexed = true) {
+        const size_t total = totalColumn();
+        for (uint32_t ordinal = 0; ordinal < studentIds.size(); ++ordinal) {
+            if (columns[total][ordinal] != MISSING) continue;
+            int sum = 0;
+            for (size_t c = 0; c < total; ++c) {
+                if (columns[c][ordinal] != MISSING) sum += columns[c][ordinal];
+            }
+            columns[total][ordinal] = sum;
+            if (indexed) indexes[total].insert(sum, studentIds[ordinal]);
+        }
+    }
+
+public:
+    explicit ColumnarStore(const vector<string>& subjects = attendanceSubjects())
+        : names(subjects), columns(subjects.size() + 1), indexes(subjects.size() + 1) {
+        names.push_back(TOTAL_COLUMN);
+    }
+
+    size_t columnCount() const { return names.size(); }
+    size_t totalColumn() const { return names.size() - 1; }
+    size_t studentCount() const { return studentIds.size(); }
+    const string& name(size_t column) const { return names[column]; }
+    const AVLTree& index(size_t column) const { return indexes[column]; }
+    AVLTree& index(size_t column) { return indexes[column]; }
+
+    // Column number for a name, or -1
+    int columnOf(const string& columnName) const {
+        for (size_t c = 0; c < names.size(); ++c) {
+            if (names[c] == columnName) return static_cast<int>(c);
+        }
+        return -1;
+    }
+
+    string snapshotFile(const string& dir, size_t column) const {
+        return dir + "/" + names[column] + ".dat";
+    }
+
+    // The student's value in a column, or MISSING
+    int value(size_t column, int studentId) const {
+        auto found = ordinals.find(studentId);
+        return found == ordinals.end() ? MISSING : columns[column][found->second];
+    }
+
+    // The total a student ends up with when a subject moves from oldValue
+    // to newValue, as set() computes it; missing values count as 0.
+    static int movedTotal(int total, int oldValue, int newValue) {
+        return (total == MISSING ? 0 : total) + newValue - (oldValue == MISSING ? 0 : oldValue);
+    }
+
+    // Sets a subject value and moves total_attendance by the same delta.
+    // Returns true if the student already had a value for the subject.
+    bool set(size_t column, int studentId, int newValue) {
+        uint32_t ordinal = ordinalFor(studentId);
+        int& slot = columns[column][ordinal];
+        const bool existed = slot != MISSING;
+        int& total = columns[totalColumn()][ordinal];
+        const int newTotal = movedTotal(total, slot, newValue);
+        slot = newValue;
+        indexes[column].updateAttendance(studentId, newValue);
+
+        if (newTotal != total) {
+            total = newTotal;
+            indexes[totalColumn()].updateAttendance(studentId, newTotal);
+        }
+        return existed;
+    }
+
+    // Loads each column from <dir>/<column>.dat and its update log. Columns
+    // without a snapshot start empty and are reported through missing.
+    void load(const string& dir, vector<string>* missing = nullptr) {
+        *this = ColumnarStore(vector<string>(names.begin(), names.end() - 1));
+        for (size_t c = 0; c < names.size(); ++c) {
+            if (!indexes[c].deserialize(snapshotFile(dir, c))) {
+                if (missing) missing->push_back(snapshotFile(dir, c));
+                indexes[c] = AVLTree();
+                continue;
+            }
+            indexes[c].forEach([&](int attendance, int studentId) {
+                columns[c][ordinalFor(studentId)] = attendance;
+            });
+        }
+        deriveMissingTotals();
+    }
+
+    // Loads attendance.csv (student_id, name, one column per subject and an
+    // optional total_attendance). Empty cells are MISSING.
+    bool loadCSV(const string& filename) {
+        if (!readCSV(filename)) return false;
+        for (size_t c = 0; c < names.size(); ++c) buildIndex(c);
+        return true;
+    }
+
+    // The parsing half of loadCSV: fills the columns (totals included) but
+    // leaves every index empty until buildIndex is called for it. Different
+    // columns' indexes can be built concurrently.
+    bool readCSV(const string& filename) {
+        *this = ColumnarStore(vector<string>(names.begin(), names.end() - 1));
+        CSVReader csv;
+        if (!csv.open(filename) || !csv.next()) return false;
+        const int idField = csv.find("student_id");
+        vector<int> fieldOf(names.size(), -1);
+        for (size_t c = 0; c < names.size(); ++c) fieldOf[c] = csv.find(names[c]);
+        if (idField < 0) return false;
+
+        while (csv.next()) {
+            int studentId, cell;
+            if (static_cast<size_t>(idField) >= csv.size() || !parseCSVInt(csv[idField], studentId)) continue;
+            uint32_t ordinal = ordinalFor(studentId);
+            for (size_t c = 0; c < names.size(); ++c) {
+                if (fieldOf[c] >= 0 && static_cast<size_t>(fieldOf[c]) < csv.size() &&
+                    parseCSVInt(csv[fieldOf[c]], cell)) {
+                    columns[c][ordinal] = cell;
+                }
+            }
+        }
+
+        deriveMissingTotals(false);
+        return true;
+    }
+
+    // Bulk-loads a column's index from the column.
+    void buildIndex(size_t column) {
+        vector<pair<int, int>> records;
+        records.reserve(studentIds.size());
+        for (uint32_t ordinal = 0; ordinal < studentIds.size(); ++ordinal) {
+            if (columns[column][ordinal] != MISSING) records.emplace_back(columns[column][ordinal], studentIds[ordinal]);
+        }
+        indexes[column] = AVLTree();
+        indexes[column].bulkLoad(records);
+    }
+
+    // Parses "<column><op><value>" with op one of < <= > >= = ==.
+    bool parseCondition(const string& text, ColumnRange& range) const {
+        size_t opStart = text.find_first_of("<>=");
+        if (opStart == string::npos || opStart == 0) return false;
+        size_t opEnd = text.find_first_not_of("<>=", opStart);
+        if (opEnd == string::npos) return false;
+        int column = columnOf(text.substr(0, opStart));
+        int bound;
+        if (column < 0 || !parseCSVInt(string_view(text).substr(opEnd), bound)) return false;
+
+        const string op = text.substr(opStart, opEnd - opStart);
+        range = {static_cast<size_t>(column), INT_MIN, INT_MAX};
+        if (op == "<" && bound > INT_MIN) range.hi = bound - 1;
+        else if (op == "<=") range.hi = bound;
+        else if (op == ">" && bound < INT_MAX) range.lo = bound + 1;
+        else if (op == ">=") range.lo = bound;
+        else if (op == "=" || op == "==") range.lo = range.hi = bound;
+        else return false;
+        return true;
+    }
+
+    // Student IDs satisfying every condition, highest value of the driving
+    // column first. The condition matching the fewest students (an O(log n)
+    // count on each column's index) drives through its index and the rest
+    // are checked against the dense columns.
+    vector<int> select(const vector<ColumnRange>& ranges) const {
+        vector<int> result;
+        if (ranges.empty()) return result;
+        size_t driver = 0, fewest = SIZE_MAX;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            size_t count = indexes[ranges[i].column].countInRange(ranges[i].lo, ranges[i].hi);
+            if (count < fewest) {
+                fewest = count;
+                driver = i;
+            }
+        }
+        if (fewest == 0) return result;
+        result.reserve(fewest);
+        for (int studentId : indexes[ranges[driver].column].getStudentIdsInRange(ranges[driver].lo, ranges[driver].hi)) {
+            const uint32_t ordinal = ordinals.at(studentId);
+            bool matches = true;
+            for (size_t i = 0; i < ranges.size() && matches; ++i) {
+                if (i == driver) continue;
+                const int cell = columns[ranges[i].column][ordinal];
+                matches = cell != MISSING && cell >= ranges[i].lo && cell <= ranges[i].hi;
+            }
+            if (matches) result.push_back(studentId);
+        }
+        return result;
+    }
+};
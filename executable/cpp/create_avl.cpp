@@ -8,36 +8,50 @@ using namespace std;
 
 // Main function: builds AVL from stdin data and serializes to file
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <output_dat_filename>" << endl;
+    MetricsReport metrics("create_avl", argc, argv);
+    const bool incremental = argc == 3 && string(argv[1]) == "--incremental";
+    if (argc != 2 && !incremental) {
+        cerr << "Usage: " << argv[0] << " [--incremental] <output_dat_filename>" << endl;
+        cerr << "  --incremental: insert records one by one instead of the bulk build" << endl;
         return 1;
     }
 
-    const string output_filename = argv[1];
+    const string output_filename = argv[argc - 1];
     AVLTree avlTree;
 
     // Read input (attendance + student_id) from stdin
     // Example input lines: "75 101", "80 102"
-    string line;
-    int attendance, studentId;
-    vector<pair<int, int>> data;
-
-    while (getline(cin, line)) {
-        if (line.empty()) continue;
-        stringstream ss(line);
-        if (ss >> attendance >> studentId) {
-            avlTree.insert(attendance, studentId);
-        } else {
+    if (incremental) {
+        string line;
+        int attendance, studentId;
+        while (getline(cin, line)) {
+            if (line.empty()) continue;
+            stringstream ss(line);
+            if (ss >> attendance >> studentId) {
+                avlTree.insert(attendance, studentId);
+            } else {
+                cerr << "Invalid input line: " << line << endl;
+            }
+        }
+    } else {
+        // Default: read everything at once, parse without iostreams, group by
+        // attendance and build a balanced tree bottom-up in O(n).
+        vector<string> invalidLines;
+        vector<pair<int, int>> records = parseAttendanceRecords(readAllInput(stdin), &invalidLines);
+        for (const auto& line : invalidLines) {
             cerr << "Invalid input line: " << line << endl;
         }
+        avlTree.bulkLoad(records);
     }
 
-    // Serialize the constructed AVL tree to file
-    if (!avlTree.serialize(output_filename)) {
+    // Serialize the constructed AVL tree to file (under the writer lock, so a
+    // concurrent update_avl cannot append to the log being replaced)
+    WriterLock lock(output_filename);
+    if (!lock.held() || !avlTree.serialize(output_filename)) {
         cerr << "Error: Failed to serialize AVL tree to " << output_filename << endl;
         return 1;
     }
 
     cout << "AVL tree created and serialized successfully: " << output_filename << endl;
     return 0;
-}
\ No newline at end of file
+}
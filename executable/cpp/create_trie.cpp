@@ -1,7 +1,5 @@
-#include "trie.h"
+#include "token_index.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
 
@@ -9,42 +7,35 @@ using namespace std;
 
 // Trie class definition and utility functions are now provided by trie.h
 
-int main() {
+int main(int argc, char* argv[]) {
+    MetricsReport metrics("create_trie", argc, argv);
     // Corrected file paths: ../data/students.csv assumes running from executable/cpp/
     // The executable needs to go up one directory (..) to 'executable', then into 'data/'.
     const string csvFilename = "../data/students.csv";
     const string trieFilename = "../serialized/name.dat";
+    const string tokensFilename = tokenIndexFile(trieFilename);
     
-    ifstream csvFile(csvFilename);
-    if (!csvFile) {
+    // The CSV is memory-mapped and parsed in place (csv_reader.h, included by trie.h)
+    CSVReader csv;
+    if (!csv.open(csvFilename)) {
         cerr << "Error opening CSV file: " << csvFilename << endl;
         return 1;
     }
     
     Trie trie;
-    string line;
-    bool isFirstLine = true;
-    
-    while (getline(csvFile, line)) {
-        if (isFirstLine) {
-            isFirstLine = false;
-            // Assuming header is present, skip the first line.
-            continue; 
-        }
-        
-        // parseCSVLine() is defined in trie.h
-        vector<string> fields = parseCSVLine(line); 
-        
-        // Check for minimum expected fields (student_id, name, rn)
-        if (fields.size() >= 3) {
-            const string& name = fields[1];
-            const string& studentId = fields[0];
-            trie.insert(name, studentId);
-        }
+    Trie tokens;  // every part of every name (token_index.h)
+    // Records in student ID order (the header is skipped)
+    vector<pair<int, string_view>> records;
+    size_t skipped = readStudentNames(csv, records);
+    if (skipped > 0) cerr << "Skipped " << skipped << " records with an invalid student ID" << endl;
+
+    for (const auto& [studentId, name] : records) {
+        trie.insert(string(name), studentId);
+        insertNameTokens(tokens, name, studentId);
     }
     
-    if (trie.serialize(trieFilename)) {
-        cout << "Trie has been successfully serialized to " << trieFilename << endl;
+    if (trie.serialize(trieFilename) && tokens.serialize(tokensFilename)) {
+        cout << "Trie has been successfully serialized to " << trieFilename << " and " << tokensFilename << endl;
         return 0;
     } else {
         cerr << "Failed to serialize the trie" << endl;
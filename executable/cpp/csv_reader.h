@@ -0,0 +1,181 @@
+#pragma once
+#include "flat_format.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Streaming CSV reader. A file is memory-mapped and walked record by record.
+// Its fields come back as string_views into the mapping, so reading a roster
+// allocates nothing per line and per field. Delimiters are found 16 bytes at a
+// time with SSE2; quoted fields are located with memchr.
+//
+// Quoting follows RFC 4180: a field that starts with a double quote runs to
+// the matching closing quote and may contain commas, line breaks and doubled
+// quotes (""). Only fields with doubled quotes are copied, into scratch space
+// that lives until the next record. Records end at \n, \r\n or \r, and blank
+// lines are skipped.
+//
+//   CSVReader csv;
+//   if (!csv.open("../data/students.csv")) ...
+//   while (csv.next()) use(csv[0], csv[1]);   // valid until the next next()
+class CSVReader {
+private:
+    MappedFile mapped;
+    string owned;                  // input read from a stream
+    const char* cursor;
+    const char* end;
+    vector<string_view> fields;
+    deque<string> unescaped;       // fields that contained "" in this record
+    size_t lineNumber;             // line breaks consumed so far
+    size_t recordLine;             // line on which the current record starts
+
+    // First of ',', '\n' or '\r' in [from, end), or end.
+    static const char* findDelimiter(const char* from, const char* end) {
+#ifdef __SSE2__
+        const __m128i comma = _mm_set1_epi8(','), newline = _mm_set1_epi8('\n'), carriage = _mm_set1_epi8('\r');
+        while (end - from >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+            __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, comma),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+            int mask = _mm_movemask_epi8(hits);
+            if (mask) return from + __builtin_ctz(mask);
+            from += 16;
+        }
+#endif
+        while (from < end && *from != ',' && *from != '\n' && *from != '\r') ++from;
+        return from;
+    }
+
+    // Reads the quoted field at cursor (on its opening quote). Text between
+    // the closing quote and the next delimiter is kept, as most readers do.
+    string_view quotedField() {
+        const char* start = ++cursor;
+        string* copy = nullptr;
+        while (true) {
+            const char* quote = static_cast<const char*>(memchr(cursor, '"', end - cursor));
+            if (!quote) {  // unterminated: the rest of the input is the field
+                cursor = end;
+                if (!copy) return string_view(start, end - start);
+                copy->append(start, end);
+                return *copy;
+            }
+            for (const char* c = cursor; c < quote; ++c) lineNumber += *c == '\n';
+            if (quote + 1 < end && quote[1] == '"') {
+                if (!copy) copy = &unescaped.emplace_back();
+                copy->append(start, quote + 1);
+                start = cursor = quote + 2;
+                continue;
+            }
+            const char* after = quote + 1;
+            const char* delimiter = findDelimiter(after, end);
+            cursor = delimiter;
+            if (!copy && delimiter == after) return string_view(start, quote - start);
+            if (!copy) copy = &unescaped.emplace_back();
+            copy->append(start, quote);
+            copy->append(after, delimiter);
+            return *copy;
+        }
+    }
+
+public:
+    CSVReader() : cursor(nullptr), end(nullptr), lineNumber(0), recordLine(0) {}
+    CSVReader(const CSVReader&) = delete;
+    CSVReader& operator=(const CSVReader&) = delete;
+
+    // Maps a file; an empty file has no records. False if it cannot be read.
+    bool open(const string& filename) {
+        owned.clear();
+        if (mapped.open(filename)) {
+            madvise(const_cast<char*>(mapped.data()), mapped.size(), MADV_SEQUENTIAL);
+            reset(string_view(mapped.data(), mapped.size()));
+            return true;
+        }
+        FILE* file = fopen(filename.c_str(), "rb");
+        if (!file) return false;
+        bool empty = fgetc(file) == EOF;
+        fclose(file);
+        reset(string_view());
+        return empty;
+    }
+
+    // Reads a whole stream (e.g. stdin) in large chunks and parses it.
+    bool read(FILE* stream) {
+        mapped.close();
+        owned.clear();
+        char buffer[1 << 16];
+        size_t got;
+        while ((got = fread(buffer, 1, sizeof(buffer), stream)) > 0) owned.append(buffer, got);
+        Metrics::add(Counter::BytesRead, owned.size());
+        reset(owned);
+        return !ferror(stream);
+    }
+
+    // Parses data in place; it must outlive the reader's use of it.
+    void reset(string_view data) {
+        cursor = data.data();
+        end = data.data() + data.size();
+        lineNumber = recordLine = 0;
+        fields.clear();
+        unescaped.clear();
+    }
+
+    // Advances to the next non-blank record; false at the end of the input.
+    bool next() {
+        fields.clear();
+        unescaped.clear();
+        while (cursor < end && (*cursor == '\n' || *cursor == '\r')) {
+            if (*cursor == '\n' || cursor + 1 == end || cursor[1] != '\n') ++lineNumber;
+            ++cursor;
+        }
+        if (cursor >= end) return false;
+        recordLine = ++lineNumber;
+        while (true) {
+            if (*cursor == '"') {
+                fields.push_back(quotedField());
+            } else {
+                const char* delimiter = findDelimiter(cursor, end);
+                fields.emplace_back(cursor, delimiter - cursor);
+                cursor = delimiter;
+            }
+            if (cursor >= end) return true;
+            if (*cursor != ',') {  // end of the record
+                cursor += *cursor == '\r' && cursor + 1 < end && cursor[1] == '\n' ? 2 : 1;
+                return true;
+            }
+            if (++cursor == end) {  // trailing comma: one last empty field
+                fields.emplace_back();
+                return true;
+            }
+        }
+    }
+
+    size_t size() const { return fields.size(); }
+    string_view operator[](size_t field) const { return fields[field]; }
+    const vector<string_view>& record() const { return fields; }
+    // 1-based line of the input on which the current record starts.
+    size_t line() const { return recordLine; }
+
+    // Field number of a header name, or -1
+    int find(string_view name) const {
+        for (size_t f = 0; f < fields.size(); ++f) {
+            if (fields[f] == name) return static_cast<int>(f);
+        }
+        return -1;
+    }
+};
+
+// Parses a whole field as a decimal int.
+inline bool parseCSVInt(string_view text, int& value) {
+    auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    return error == errc() && end == text.data() + text.size() && !text.empty();
+}
@@ -0,0 +1,120 @@
+#include "hnsw.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+using namespace std;
+
+// Face recognition: prints the student ID closest to each query embedding,
+// or -1 when no enrolled face is within the threshold; with --distances each
+// line also carries the distance to the closest face.
+// Queries arrive on stdin as raw little-endian float32 vectors of
+// FACE_EMBEDDING_DIM values (512 bytes each); the embeddings are loaded once,
+// so any number of queries can be piped through one process. Queries are
+// read in batches and matched in parallel (--threads, default all cores).
+// With --index, queries go to a prebuilt HNSW index (see hnsw_index) instead
+// of an exact scan of the CSV; --ef sets its search width.
+// Example: ./distance --metric cosine --threshold 0.2 < query.bin
+//          ./distance --index ../serialized/faces.hnsw --ef 128 < query.bin
+int main(int argc, char* argv[]) {
+    FaceMetric metric = FaceMatcher::configuredMetric();
+    string thresholdText;
+    string studentsFilename = "../data/students.csv";
+    string indexFilename;
+    size_t ef = HNSWIndex::configuredEf();
+    size_t threads = matchThreadCount();
+    bool withDistances = false;
+
+    bool usageError = false;
+    for (int i = 1; i < argc && !usageError; i += 2) {
+        const string option = argv[i];
+        if (option == "--distances") {
+            withDistances = true;
+            --i;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usageError = true;
+        } else if (option == "--metric") {
+            usageError = !FaceMatcher::parseMetric(argv[i + 1], metric);
+        } else if (option == "--threshold") {
+            thresholdText = argv[i + 1];
+        } else if (option == "--students") {
+            studentsFilename = argv[i + 1];
+        } else if (option == "--index") {
+            indexFilename = argv[i + 1];
+        } else if (option == "--ef") {
+            long value = strtol(argv[i + 1], nullptr, 10);
+            usageError = value <= 0;
+            ef = static_cast<size_t>(value);
+        } else if (option == "--threads") {
+            long value = strtol(argv[i + 1], nullptr, 10);
+            usageError = value <= 0;
+            threads = static_cast<size_t>(value);
+        } else {
+            usageError = true;
+        }
+    }
+    // An index fixes its own metric.
+    HNSWIndex index;
+    if (!usageError && !indexFilename.empty()) {
+        if (!index.load(indexFilename)) {
+            cerr << "Error: Failed to load face index " << indexFilename << endl;
+            return 1;
+        }
+        metric = index.getMetric();
+    }
+    float threshold = FaceMatcher::configuredThreshold(metric);
+    if (!usageError && !thresholdText.empty()) {
+        try {
+            size_t used;
+            threshold = stof(thresholdText, &used);
+            usageError = used != thresholdText.size() || threshold < 0.0f;
+        } catch (const exception&) {
+            usageError = true;
+        }
+    }
+    if (usageError) {
+        cerr << "Usage: " << argv[0] << " [--metric l2|cosine] [--threshold T] [--students <csv>] [--threads N] [--distances] < queries.bin" << endl;
+        cerr << "       " << argv[0] << " --index <faces.hnsw> [--ef N] [--threshold T] [--threads N] [--distances] < queries.bin" << endl;
+        cerr << "  each query is " << FACE_EMBEDDING_DIM << " little-endian float32 values on stdin" << endl;
+        return 1;
+    }
+
+    FaceMatcher matcher(metric);
+    size_t skipped = 0;
+    if (indexFilename.empty() && !matcher.load(studentsFilename, &skipped)) {
+        cerr << "Error opening CSV file: " << studentsFilename << endl;
+        return 1;
+    }
+    if (skipped > 0) {
+        cerr << "Warning: skipped " << skipped << " rows without a valid facial_vector" << endl;
+    }
+
+    const size_t BATCH = 1024;
+    const size_t queryBytes = FACE_EMBEDDING_DIM * sizeof(float);
+    vector<float> queries(BATCH * FACE_EMBEDDING_DIM);
+    size_t answered = 0;
+    size_t got;
+    while ((got = fread(queries.data(), 1, BATCH * queryBytes, stdin)) >= queryBytes) {
+        size_t count = got / queryBytes;
+        vector<FaceMatch> matches = indexFilename.empty()
+            ? matcher.matchBatch(queries.data(), count, threshold, threads)
+            : index.matchBatch(queries.data(), count, threshold, ef, threads);
+        for (const auto& match : matches) {
+            cout << match.studentId;
+            if (withDistances) cout << ' ' << match.distance;
+            cout << '\n';
+        }
+        answered += count;
+        got %= queryBytes;
+        if (got != 0) break;
+    }
+    cout.flush();
+    if (got != 0 || answered == 0) {
+        cerr << "Error: expected " << queryBytes << "-byte query vectors on stdin" << endl;
+        return 1;
+    }
+    return 0;
+}
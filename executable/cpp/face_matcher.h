@@ -0,0 +1,434 @@
+#pragma once
+#include "csv_reader.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Nearest-neighbour matcher for face embeddings.
+// Every enrolled embedding lives in one contiguous, 64-byte aligned float
+// matrix (one row per student), loaded once from the facial_vector column of
+// students.csv. A query is a brute-force scan with SIMD distance kernels picked
+// at runtime (AVX-512, AVX2+FMA, or a portable scalar loop).
+
+inline constexpr size_t FACE_EMBEDDING_DIM = 128;
+
+enum class FaceMetric { L2, Cosine };
+
+// Distance kernels over FACE_EMBEDDING_DIM floats; rows are 64-byte aligned
+// and the dimension is a multiple of 16, so no tail handling is needed.
+namespace face_kernels {
+
+inline float squaredL2Scalar(const float* a, const float* b) {
+    // Independent accumulators keep the FP adds from serializing.
+    float sums[8] = {};
+    for (size_t i = 0; i < FACE_EMBEDDING_DIM; i += 8) {
+        for (size_t j = 0; j < 8; ++j) {
+            float d = a[i + j] - b[i + j];
+            sums[j] += d * d;
+        }
+    }
+    return ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+}
+
+inline float dotScalar(const float* a, const float* b) {
+    float sums[8] = {};
+    for (size_t i = 0; i < FACE_EMBEDDING_DIM; i += 8) {
+        for (size_t j = 0; j < 8; ++j) {
+            sums[j] += a[i + j] * b[i + j];
+        }
+    }
+    return ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+inline float horizontalSum(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma")))
+inline float squaredL2Avx2(const float* a, const float* b) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < FACE_EMBEDDING_DIM; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_load_ps(a + i), _mm256_load_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_load_ps(a + i + 8), _mm256_load_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    return horizontalSum(_mm256_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx2,fma")))
+inline float dotAvx2(const float* a, const float* b) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < FACE_EMBEDDING_DIM; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(a + i), _mm256_load_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_load_ps(a + i + 8), _mm256_load_ps(b + i + 8), acc1);
+    }
+    return horizontalSum(_mm256_add_ps(acc0, acc1));
+}
+
+// Spills the lanes rather than using _mm512_reduce_add_ps, which trips a
+// spurious -Wuninitialized in some GCC versions.
+__attribute__((target("avx512f")))
+inline float horizontalSum(__m512 v) {
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, v);
+    float sum = 0.0f;
+    for (float lane : lanes) sum += lane;
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+inline float squaredL2Avx512(const float* a, const float* b) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    for (size_t i = 0; i < FACE_EMBEDDING_DIM; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_load_ps(a + i), _mm512_load_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_load_ps(a + i + 16), _mm512_load_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    return horizontalSum(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f")))
+inline float dotAvx512(const float* a, const float* b) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    for (size_t i = 0; i < FACE_EMBEDDING_DIM; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_load_ps(a + i), _mm512_load_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_load_ps(a + i + 16), _mm512_load_ps(b + i + 16), acc1);
+    }
+    return horizontalSum(_mm512_add_ps(acc0, acc1));
+}
+#endif
+
+using Kernel = float (*)(const float*, const float*);
+
+struct KernelSet {
+    Kernel squaredL2;
+    Kernel dot;
+    const char* name;
+};
+
+// Best kernels the running CPU supports, resolved once.
+inline const KernelSet& selected() {
+    static const KernelSet kernels = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return KernelSet{squaredL2Avx512, dotAvx512, "avx512"};
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return KernelSet{squaredL2Avx2, dotAvx2, "avx2"};
+        }
+#endif
+        return KernelSet{squaredL2Scalar, dotScalar, "scalar"};
+    }();
+    return kernels;
+}
+
+}  // namespace face_kernels
+
+// Growable matrix of embeddings, one 64-byte aligned row per entry. Under
+// the cosine metric rows are stored unit-length so that cosine distance is
+// 1 - dot; score() is squared Euclidean distance for L2. Either way a smaller
+// score is closer, and distanceOf() turns a score into the reported distance.
+class EmbeddingMatrix {
+private:
+    struct AlignedFree {
+        void operator()(float* p) const { free(p); }
+    };
+
+    FaceMetric metric;
+    face_kernels::Kernel kernel;
+    unique_ptr<float, AlignedFree> rows;
+    size_t count;
+    size_t capacity;
+
+    static constexpr size_t ROW_BYTES = FACE_EMBEDDING_DIM * sizeof(float);
+
+    // Returns false for a zero vector, which has no direction to compare.
+    static bool normalize(float* row) {
+        float norm = sqrt(face_kernels::dotScalar(row, row));
+        if (!(norm > 0.0f) || !isfinite(norm)) return false;
+        for (size_t i = 0; i < FACE_EMBEDDING_DIM; ++i) row[i] /= norm;
+        return true;
+    }
+
+public:
+    explicit EmbeddingMatrix(FaceMetric m = FaceMetric::L2)
+        : metric(m),
+          kernel(m == FaceMetric::L2 ? face_kernels::selected().squaredL2 : face_kernels::selected().dot),
+          count(0), capacity(0) {}
+
+    FaceMetric getMetric() const { return metric; }
+    size_t size() const { return count; }
+    const float* row(size_t i) const { return rows.get() + i * FACE_EMBEDDING_DIM; }
+
+    bool reserve(size_t wanted) {
+        if (wanted <= capacity) return true;
+        float* grown = static_cast<float*>(aligned_alloc(64, wanted * ROW_BYTES));
+        if (!grown) return false;
+        if (rows) memcpy(grown, rows.get(), count * ROW_BYTES);
+        rows.reset(grown);
+        capacity = wanted;
+        return true;
+    }
+
+    // Copies `query` into an aligned buffer of FACE_EMBEDDING_DIM floats in the
+    // form score() expects; false if it cannot be compared (non-finite, or all
+    // zeros under cosine).
+    bool prepare(const float* query, float* probe) const {
+        memcpy(probe, query, ROW_BYTES);
+        for (size_t i = 0; i < FACE_EMBEDDING_DIM; ++i) {
+            if (!isfinite(probe[i])) return false;
+        }
+        return metric == FaceMetric::L2 || normalize(probe);
+    }
+
+    // Appends an embedding; false if prepare() rejects it.
+    bool append(const float* embedding) {
+        if (count == capacity && !reserve(max<size_t>(capacity * 2, 64))) return false;
+        if (!prepare(embedding, rows.get() + count * FACE_EMBEDDING_DIM)) return false;
+        ++count;
+        return true;
+    }
+
+    float score(const float* probe, size_t i) const {
+        float value = kernel(probe, row(i));
+        return metric == FaceMetric::L2 ? value : 1.0f - value;
+    }
+
+    float distanceOf(float score) const {
+        return metric == FaceMetric::L2 ? sqrt(max(score, 0.0f)) : score;
+    }
+};
+
+// Parses a comma-joined embedding as stored in students.csv.
+inline bool parseEmbedding(string_view text, vector<float>& out) {
+    out.clear();
+    const char* cursor = text.data();
+    const char* end = text.data() + text.size();
+    while (cursor < end && *cursor == ' ') ++cursor;
+    while (cursor < end) {
+        float value;
+        auto [next, error] = from_chars(cursor, end, value);
+        if (error != errc() || !isfinite(value)) return false;
+        out.push_back(value);
+        cursor = next;
+        while (cursor < end && *cursor == ' ') ++cursor;
+        if (cursor < end && *cursor == ',') ++cursor;
+        while (cursor < end && *cursor == ' ') ++cursor;
+    }
+    return out.size() == FACE_EMBEDDING_DIM;
+}
+
+// Calls add(studentId, embedding) for every row of a students.csv with
+// student_id and facial_vector columns. Rows without a parsable embedding, or
+// that add() rejects, are counted in `skipped`. A file without a
+// facial_vector column has no rows to visit. False if the file cannot be opened.
+template <typename Add>
+bool forEachFaceEmbedding(const string& csvFilename, Add&& add, size_t* skipped = nullptr) {
+    if (skipped) *skipped = 0;
+    CSVReader csv;
+    if (!csv.open(csvFilename)) return false;
+    if (!csv.next()) return true;
+    const int idColumn = csv.find("student_id");
+    const int vectorColumn = csv.find("facial_vector");
+    if (idColumn < 0 || vectorColumn < 0) return true;
+
+    vector<float> embedding;
+    int studentId;
+    while (csv.next()) {
+        bool added = csv.size() > static_cast<size_t>(max(idColumn, vectorColumn)) &&
+                     parseCSVInt(csv[idColumn], studentId) &&
+                     parseEmbedding(csv[vectorColumn], embedding) &&
+                     add(studentId, embedding.data());
+        if (!added && skipped) ++*skipped;
+    }
+    return true;
+}
+
+// One answer of a batch match: the student ID (or -1 past the threshold)
+// and the distance to the closest enrolled face (infinity if none).
+struct FaceMatch {
+    int studentId;
+    float distance;
+};
+
+// Threads used for batch matching; override with ATTENDANCE_MATCH_THREADS.
+inline size_t matchThreadCount() {
+    const char* configured = getenv("ATTENDANCE_MATCH_THREADS");
+    if (configured) {
+        long value = strtol(configured, nullptr, 10);
+        if (value > 0) return static_cast<size_t>(value);
+    }
+    return max<size_t>(thread::hardware_concurrency(), 1);
+}
+
+// Splits [0, count) into at most `threads` contiguous chunks and runs
+// work(chunk, begin, end) for each, on the calling thread plus spawned ones.
+template <typename Work>
+void parallelChunks(size_t count, size_t threads, Work&& work) {
+    size_t chunks = max<size_t>(min(threads, count), 1);
+    vector<thread> workers;
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        workers.emplace_back([&work, chunk, chunks, count] {
+            work(chunk, count * chunk / chunks, count * (chunk + 1) / chunks);
+        });
+    }
+    work(0, 0, count / chunks);
+    for (auto& worker : workers) worker.join();
+}
+
+// Exact matcher: scans every enrolled embedding.
+class FaceMatcher {
+private:
+    vector<int> studentIds;
+    EmbeddingMatrix embeddings;
+
+public:
+    explicit FaceMatcher(FaceMetric m = FaceMetric::L2) : embeddings(m) {}
+
+    FaceMetric getMetric() const { return embeddings.getMetric(); }
+    size_t size() const { return studentIds.size(); }
+    static const char* kernelName() { return face_kernels::selected().name; }
+
+    // Default acceptance threshold: dlib's 0.6 Euclidean distance, which for
+    // unit-length embeddings corresponds to a cosine distance of 0.18.
+    static float defaultThreshold(FaceMetric m) {
+        return m == FaceMetric::L2 ? 0.6f : 0.18f;
+    }
+
+    // Parses "l2" or "cosine".
+    static bool parseMetric(const string& text, FaceMetric& out) {
+        if (text == "l2") out = FaceMetric::L2;
+        else if (text == "cosine") out = FaceMetric::Cosine;
+        else return false;
+        return true;
+    }
+
+    // Metric and threshold used when none is given on the command line;
+    // override with ATTENDANCE_MATCH_METRIC and ATTENDANCE_MATCH_THRESHOLD.
+    static FaceMetric configuredMetric() {
+        FaceMetric m = FaceMetric::L2;
+        const char* configured = getenv("ATTENDANCE_MATCH_METRIC");
+        if (configured) parseMetric(configured, m);
+        return m;
+    }
+
+    static float configuredThreshold(FaceMetric m) {
+        const char* configured = getenv("ATTENDANCE_MATCH_THRESHOLD");
+        if (configured) {
+            char* end;
+            float value = strtof(configured, &end);
+            if (end != configured && *end == '\0' && value >= 0.0f) return value;
+        }
+        return defaultThreshold(m);
+    }
+
+    // Adds one embedding; rejected if it is not a finite FACE_EMBEDDING_DIM
+    // vector (or is all zeros under the cosine metric).
+    bool add(int studentId, const float* embedding) {
+        if (!embeddings.append(embedding)) return false;
+        studentIds.push_back(studentId);
+        return true;
+    }
+
+    // Loads every embedding in a students.csv, replacing what was loaded
+    // before (see forEachFaceEmbedding).
+    bool load(const string& csvFilename, size_t* skipped = nullptr) {
+        *this = FaceMatcher(getMetric());
+        return forEachFaceEmbedding(csvFilename,
+                                    [this](int studentId, const float* embedding) { return add(studentId, embedding); },
+                                    skipped);
+    }
+
+    // Closest enrolled student to `query` (FACE_EMBEDDING_DIM floats), or -1
+    // if none lies within `threshold` (Euclidean distance for L2, 1 - cosine
+    // similarity for cosine). `distance`, if given, receives the best distance.
+    int match(const float* query, float threshold, float* distance = nullptr) const {
+        alignas(64) float probe[FACE_EMBEDDING_DIM];
+        if (studentIds.empty() || !embeddings.prepare(query, probe)) return -1;
+
+        size_t best = 0;
+        float bestScore = embeddings.score(probe, 0);
+        for (size_t i = 1; i < studentIds.size(); ++i) {
+            float score = embeddings.score(probe, i);
+            if (score < bestScore) {
+                bestScore = score;
+                best = i;
+            }
+        }
+
+        float bestDistance = embeddings.distanceOf(bestScore);
+        if (distance) *distance = bestDistance;
+        return bestDistance <= threshold ? studentIds[best] : -1;
+    }
+
+    // Matches `count` queries (consecutive FACE_EMBEDDING_DIM floats) at once.
+    // The gallery is split across threads and each thread scores all queries
+    // against its rows tile by tile, so every tile is read from memory once
+    // per batch rather than once per face; the per-thread bests are merged.
+    vector<FaceMatch> matchBatch(const float* queries, size_t count, float threshold,
+                                 size_t threads = matchThreadCount()) const {
+        constexpr size_t TILE_ROWS = 256;  // 128 KiB of gallery, stays in L2
+        const float INF = numeric_limits<float>::infinity();
+        vector<FaceMatch> result(count, {-1, INF});
+        if (count == 0 || studentIds.empty()) return result;
+
+        struct AlignedFree {
+            void operator()(float* p) const { free(p); }
+        };
+        unique_ptr<float, AlignedFree> probes(
+            static_cast<float*>(aligned_alloc(64, count * FACE_EMBEDDING_DIM * sizeof(float))));
+        if (!probes) return result;
+        vector<char> usable(count);
+        for (size_t q = 0; q < count; ++q) {
+            usable[q] = embeddings.prepare(queries + q * FACE_EMBEDDING_DIM, probes.get() + q * FACE_EMBEDDING_DIM);
+        }
+
+        size_t rowCount = studentIds.size();
+        size_t workers = max<size_t>(min(threads, (rowCount + TILE_ROWS - 1) / TILE_ROWS), 1);
+        vector<pair<float, size_t>> bests(workers * count, {INF, 0});  // (score, row) per worker and query
+        parallelChunks(rowCount, workers, [&](size_t worker, size_t begin, size_t end) {
+            pair<float, size_t>* mine = bests.data() + worker * count;
+            for (size_t tile = begin; tile < end; tile += TILE_ROWS) {
+                size_t tileEnd = min(tile + TILE_ROWS, end);
+                for (size_t q = 0; q < count; ++q) {
+                    if (!usable[q]) continue;
+                    const float* probe = probes.get() + q * FACE_EMBEDDING_DIM;
+                    for (size_t row = tile; row < tileEnd; ++row) {
+                        float score = embeddings.score(probe, row);
+                        if (score < mine[q].first) mine[q] = {score, row};
+                    }
+                }
+            }
+        });
+
+        for (size_t q = 0; q < count; ++q) {
+            pair<float, size_t> best = {INF, 0};
+            for (size_t worker = 0; worker < workers; ++worker) {
+                best = min(best, bests[worker * count + q]);
+            }
+            if (best.first == INF) continue;
+            float bestDistance = embeddings.distanceOf(best.first);
+            result[q] = {bestDistance <= threshold ? studentIds[best.second] : -1, bestDistance};
+        }
+        return result;
+    }
+};
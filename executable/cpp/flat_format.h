@@ -0,0 +1,254 @@
+#pragma once
+#include "metrics.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Flat, offset-based on-disk format shared by the AVL and Trie indexes.
+// Files are a fixed header followed by plain arrays, so readers can mmap them
+// and query in place without rebuilding any nodes. Every record is 4-byte
+// aligned and stored little-endian.
+//
+// Both indexes keep their student IDs in one compressed ID pool (version 3;
+// see posting_list.h): the int32 IDs in index order, cut into blocks of
+// ID_POOL_BLOCK IDs. Each block has a skip entry with its first ID and the
+// offset of its remaining IDs in idBytes, stored as zigzag varints of the
+// difference from the previous ID. Every index stores each key's or name's
+// IDs sorted, so those differences are mostly one or two bytes. ID i is
+// found by decoding at most one block, and a sorted run is searched by
+// binary search over the skip entries.
+//
+// AVL index (magic "AVLX"):
+//   FlatAVLHeader                   logGeneration ties the file to its update log
+//   FlatAVLKey keys[keyCount]   sorted by ascending attendance; keys[i] owns
+//                               pool IDs [idBegin, idBegin + idCount)
+//   FlatIdBlock blocks[ceil(idCount / ID_POOL_BLOCK)]
+//   uint8_t    idBytes[idBytes]
+//
+// Trie index (magic "TRIX", version 3: path-compressed radix trie):
+//   FlatTrieHeader
+//   FlatTrieNode nodes[nodeCount]    breadth-first, node 0 is the root, so
+//                                    each node's children are contiguous
+//   char         firstBytes[nodeCount]  first label byte per node, for
+//                                    binary search over a child range
+//   char         labels[labelBytes]  edge labels, back to back
+//   FlatIdBlock  blocks[ceil(idCount / ID_POOL_BLOCK)]
+//   uint8_t      idBytes[idBytes]
+// Children are sorted by first byte and student IDs are numbered in
+// depth-first (lexicographic) order, so every ID under a node lies in
+// [idBegin, subtreeIdEnd) and a prefix search is one contiguous slice.
+// Byte arrays are zero-padded to a multiple of 4.
+//
+// Older versions are still read: AVL versions 1 and 2 store a plain
+// int32_t ids[idCount] in insertion order (version 1 also lacks
+// logGeneration, a 16-byte header); trie version 2 stores the IDs as
+// strings (uint32_t idOffsets[idCount + 1], then the characters), and
+// version 1 tries (one node per character, FlatTrieNodeV1/FlatTrieEdgeV1)
+// are read through Trie::deserialize.
+
+inline constexpr uint32_t FLAT_AVL_VERSION = 3;
+inline constexpr uint32_t FLAT_TRIE_VERSION = 3;
+inline constexpr uint32_t ID_POOL_BLOCK = 128;
+
+struct FlatAVLHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t keyCount;
+    uint32_t idCount;
+    uint32_t logGeneration;
+    uint32_t idBytes;  // version 3
+};
+
+inline size_t flatAVLHeaderSize(uint32_t version) {
+    return version == 1 ? offsetof(FlatAVLHeader, logGeneration)
+         : version == 2 ? offsetof(FlatAVLHeader, idBytes)
+                        : sizeof(FlatAVLHeader);
+}
+
+struct FlatAVLKey {
+    int32_t attendance;
+    uint32_t idBegin;
+    uint32_t idCount;
+};
+
+struct FlatTrieHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t labelBytes;  // version 1: edgeCount
+    uint32_t idCount;
+    uint32_t charCount;   // version 3: idBytes of the ID pool
+};
+
+struct FlatTrieNode {
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t labelOffset;
+    uint32_t labelLength;
+    uint32_t idBegin;       // first ID stored at this node
+    uint32_t ownIdCount;    // IDs of names ending exactly here
+    uint32_t subtreeIdEnd;  // one past the last ID anywhere below this node
+};
+
+struct FlatTrieNodeV1 {
+    uint32_t firstEdge;
+    uint32_t edgeCount;
+    uint32_t idBegin;
+    uint32_t ownIdCount;
+    uint32_t subtreeIdEnd;
+};
+
+struct FlatTrieEdgeV1 {
+    uint32_t child;
+    char label;
+    char padding[3];
+};
+
+// Skip entry of a compressed ID pool: block b holds pool IDs
+// [b * ID_POOL_BLOCK, (b + 1) * ID_POOL_BLOCK).
+struct FlatIdBlock {
+    int32_t first;        // the block's first ID
+    uint32_t byteOffset;  // where the varints of the others start in idBytes
+};
+
+inline size_t paddedTo4(size_t length) {
+    return (length + 3) & ~size_t(3);
+}
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+
+public:
+    MappedFile() : bytes(nullptr), length(0) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string& filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        bytes = static_cast<const char*>(mapped);
+        length = info.st_size;
+        Metrics::add(Counter::BytesMapped, length);
+        return true;
+    }
+
+    void close() {
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+// True if the file starts with the given 4-byte magic (legacy files do not).
+inline bool hasFlatMagic(const string& filename, const char* magic) {
+    ifstream inFile(filename, ios::binary);
+    char found[4];
+    if (!inFile.read(found, sizeof(found))) return false;
+    return memcmp(found, magic, sizeof(found)) == 0;
+}
+
+inline bool hasFlatMagic(const char* bytes, size_t length, const char* magic) {
+    return length >= 4 && memcmp(bytes, magic, 4) == 0;
+}
+
+// Writes to "<filename>.tmp", flushes it to disk and renames it over the
+// target, so readers never observe a half-written index and a crash leaves
+// either the old or the new file.
+inline bool writeFileAtomically(const string& filename, const vector<char>& contents) {
+    const string tempFilename = filename + ".tmp";
+    int fd = ::open(tempFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    size_t written = 0;
+    while (written < contents.size()) {
+        ssize_t n = ::write(fd, contents.data() + written, contents.size() - written);
+        if (n <= 0) {
+            ::close(fd);
+            unlink(tempFilename.c_str());
+            return false;
+        }
+        written += n;
+    }
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    if (!synced || rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        unlink(tempFilename.c_str());
+        return false;
+    }
+    Metrics::add(Counter::BytesWritten, contents.size());
+    return true;
+}
+
+// Exclusive advisory lock (flock on "<filename>.lock") held by whoever
+// writes an index file or its update log, so concurrent update_avl runs and
+// the engine never interleave an append with a compaction or race on the
+// ".tmp" file. Readers never take it: snapshots are swapped in by rename and
+// stay valid while mapped, log records are checksummed, and loaders
+// re-check the snapshot generation after reading the log (see AVLView::open).
+class WriterLock {
+private:
+    int fd;
+
+public:
+    explicit WriterLock(const string& filename)
+        : fd(::open((filename + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) {
+        while (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+    WriterLock(const WriterLock&) = delete;
+    WriterLock& operator=(const WriterLock&) = delete;
+    ~WriterLock() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool held() const { return fd >= 0; }
+};
+
+template <typename T>
+inline void appendRecord(vector<char>& buffer, const T& record) {
+    const char* raw = reinterpret_cast<const char*>(&record);
+    buffer.insert(buffer.end(), raw, raw + sizeof(T));
+}
+
+template <typename T>
+inline void appendRecords(vector<char>& buffer, const vector<T>& records) {
+    const char* raw = reinterpret_cast<const char*>(records.data());
+    buffer.insert(buffer.end(), raw, raw + records.size() * sizeof(T));
+}
+
+// Appends raw bytes followed by zero padding up to a multiple of 4.
+inline void appendPaddedBytes(vector<char>& buffer, const string& bytes) {
+    buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+    buffer.resize(buffer.size() + paddedTo4(bytes.size()) - bytes.size(), '\0');
+}
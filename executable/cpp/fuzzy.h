@@ -0,0 +1,224 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+// Typo-tolerant name matching for the Trie and TrieView fuzzy searches.
+//
+// Names and queries are compared as folded code points: UTF-8 is decoded,
+// ASCII and Latin letters lose case, and Latin-1 / Latin Extended-A letters
+// lose their diacritics ("Émilie" matches "emilie"). A name matches when
+// some prefix of it is within the edit budget of the query. That is the
+// type-ahead reading of a query, so "aarav" finds "Aarav Sharma" at distance
+// 0 and "Arav Mehta" finds "Aarav Mehta" at distance 1.
+//
+// The search walks the trie with a Levenshtein automaton for the query. Its
+// state is the current row of the edit-distance table, restricted to the
+// budget: a cell over budget is stored as budget + 1. Each code point on an
+// edge advances the row in O(query length). A branch is abandoned as soon as
+// every cell of its row is over budget. Row minima never decrease along a
+// path, so once the minimum reaches the best distance already seen on the
+// path, every name below shares that distance. The walk then emits the
+// subtree without running the automaton any further.
+
+// Folded form of a code point (see above); others are returned unchanged.
+inline uint32_t foldCodepoint(uint32_t c) {
+    // Base letter of U+00C0..U+017F, '.' where there is none
+    static const char* const LATIN =
+        "aaaaaa.ceeeeiiiidnooooo.ouuuuy.."   // U+00C0
+        "aaaaaa.ceeeeiiiidnooooo.ouuuuy.y"   // U+00E0
+        "aaaaaaccccccccddddeeeeeeeeeegggg"   // U+0100
+        "gggghhhhiiiiiiiiii..jjkkklllllll"   // U+0120
+        "lllnnnnnnn..oooooo..rrrrrrssssss"   // U+0140
+        "ssttttttuuuuuuuuuuuuwwyyyzzzzzzs";  // U+0160
+    if (c < 0x80) return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    if (c < 0xC0 || c >= 0x180) return c;
+    char base = LATIN[c - 0xC0];
+    if (base != '.') return static_cast<unsigned char>(base);
+    if (c >= 0xC0 && c <= 0xDE && c != 0xD7) return c + 0x20;   // Æ Þ -> æ þ
+    if (c == 0x132 || c == 0x14A || c == 0x152) return c | 1;   // Ĳ Ŋ Œ -> ĳ ŋ œ
+    return c;
+}
+
+// Incremental UTF-8 decoder: push() bytes one at a time and it reports
+// each completed code point. Bytes that are not valid UTF-8 stand for
+// themselves, so arbitrary names still compare byte by byte.
+struct Utf8Decoder {
+    uint32_t partial = 0;
+    uint8_t pending = 0;   // continuation bytes still expected
+
+    // True when `byte` completes a code point, stored in `codepoint`.
+    bool push(unsigned char byte, uint32_t& codepoint) {
+        if (pending > 0 && (byte & 0xC0) == 0x80) {
+            partial = (partial << 6) | (byte & 0x3F);
+            if (--pending > 0) return false;
+            codepoint = partial;
+            return true;
+        }
+        pending = 0;
+        if (byte >= 0xC2 && byte <= 0xDF) { partial = byte & 0x1F; pending = 1; return false; }
+        if (byte >= 0xE0 && byte <= 0xEF) { partial = byte & 0x0F; pending = 2; return false; }
+        if (byte >= 0xF0 && byte <= 0xF4) { partial = byte & 0x07; pending = 3; return false; }
+        codepoint = byte;
+        return true;
+    }
+};
+
+// Folded code points of a string.
+inline vector<uint32_t> foldName(string_view text) {
+    vector<uint32_t> folded;
+    Utf8Decoder decoder;
+    uint32_t codepoint;
+    for (char c : text) {
+        if (decoder.push(static_cast<unsigned char>(c), codepoint)) folded.push_back(foldCodepoint(codepoint));
+    }
+    return folded;
+}
+
+// Folded form of a string, re-encoded as UTF-8: a key on which names that
+// differ only in case or diacritics compare equal.
+inline string foldText(string_view text) {
+    string folded;
+    folded.reserve(text.size());
+    for (uint32_t c : foldName(text)) {
+        if (c < 0x80) {
+            folded += static_cast<char>(c);
+        } else if (c < 0x800) {
+            folded += static_cast<char>(0xC0 | (c >> 6));
+            folded += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            folded += static_cast<char>(0xE0 | (c >> 12));
+            folded += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            folded += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            folded += static_cast<char>(0xF0 | (c >> 18));
+            folded += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            folded += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            folded += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return folded;
+}
+
+// Largest edit budget the tools and the engine accept; beyond it short
+// queries match nearly every name.
+constexpr int MAX_FUZZY_DISTANCE = 3;
+
+// Edit budget used when the caller does not give one, by query length in
+// code points: exact up to 2, one edit up to 5, two edits beyond.
+inline int defaultFuzzyDistance(size_t queryLength) {
+    return queryLength <= 2 ? 0 : queryLength <= 5 ? 1 : 2;
+}
+
+struct FuzzyMatch {
+    int studentId;
+    int distance;
+};
+
+// Levenshtein automaton for one query (see the top of this file).
+class FuzzyAutomaton {
+public:
+    // Walk state after some bytes of a name: the automaton row, the least
+    // distance of any prefix so far and any unfinished UTF-8 sequence.
+    struct State {
+        vector<uint8_t> row;
+        uint8_t best;
+        Utf8Decoder decoder;
+    };
+
+private:
+    vector<uint32_t> query;
+    uint8_t cap;   // budget + 1: every cell above the budget is clamped here
+
+public:
+    FuzzyAutomaton(string_view text, int maxDistance)
+        : query(foldName(text)), cap(static_cast<uint8_t>(min(max(maxDistance, 0), 250) + 1)) {}
+
+    size_t queryLength() const { return query.size(); }
+
+    // State before any byte of a name: the empty prefix is query.size() edits away.
+    State start() const {
+        State state;
+        state.row.resize(query.size() + 1);
+        for (size_t j = 0; j <= query.size(); ++j) state.row[j] = static_cast<uint8_t>(min<size_t>(j, cap));
+        state.best = state.row.back();
+        return state;
+    }
+
+    // Least value in the row: no extension of this prefix gets below it.
+    static uint8_t floor(const State& state) {
+        return *min_element(state.row.begin(), state.row.end());
+    }
+
+    // Advances over `bytes`, stopping early once the row cannot get below
+    // state.best or is over `budget` everywhere: the rest of the label then
+    // changes nothing. False when no name continuing this prefix can match.
+    bool feed(State& state, string_view bytes, int budget) const {
+        uint32_t codepoint;
+        for (char c : bytes) {
+            if (!state.decoder.push(static_cast<unsigned char>(c), codepoint)) continue;
+            codepoint = foldCodepoint(codepoint);
+            uint8_t* row = state.row.data();
+            uint8_t diagonal = row[0];
+            row[0] = static_cast<uint8_t>(min<int>(row[0] + 1, cap));
+            uint8_t least = row[0];
+            for (size_t j = 1; j <= query.size(); ++j) {
+                uint8_t above = row[j];
+                int cell = min({above + 1, row[j - 1] + 1, diagonal + (query[j - 1] != codepoint ? 1 : 0)});
+                row[j] = static_cast<uint8_t>(min<int>(cell, cap));
+                diagonal = above;
+                least = min(least, row[j]);
+            }
+            state.best = min(state.best, row[query.size()]);
+            if (least >= state.best || least > budget) break;
+        }
+        return min(state.best, floor(state)) <= budget;
+    }
+};
+
+// Ranks matches by distance, then by the order they are found in (name
+// order, for trie walks), keeping at most `limit` (0 for all). The budget
+// shrinks as the page fills: once `limit` matches are at distance d or
+// less, only a match closer than d could still make the page.
+class FuzzyCollector {
+private:
+    vector<vector<int>> buckets;   // IDs by distance
+    size_t limit;
+    int budget;
+
+public:
+    FuzzyCollector(int maxDistance, size_t resultLimit)
+        : buckets(max(maxDistance, 0) + 1), limit(resultLimit), budget(max(maxDistance, 0)) {}
+
+    // Largest distance still worth collecting; negative once the page is final.
+    int currentBudget() const { return budget; }
+
+    void add(int studentId, int distance) {
+        if (distance > budget) return;
+        if (limit == 0 || buckets[distance].size() < limit) buckets[distance].push_back(studentId);
+        if (limit == 0) return;
+        size_t count = 0;
+        for (int d = 0; d <= budget; ++d) {
+            count += buckets[d].size();
+            if (count >= limit) {
+                budget = d - 1;
+                break;
+            }
+        }
+    }
+
+    vector<FuzzyMatch> results() const {
+        vector<FuzzyMatch> ranked;
+        for (size_t d = 0; d < buckets.size(); ++d) {
+            for (int id : buckets[d]) {
+                if (limit != 0 && ranked.size() == limit) return ranked;
+                ranked.push_back({id, static_cast<int>(d)});
+            }
+        }
+        return ranked;
+    }
+};
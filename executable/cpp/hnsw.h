@@ -0,0 +1,397 @@
+#pragma once
+#include "face_matcher.h"
+#include "flat_format.h"
+#include <string>
+#include <vector>
+#include <queue>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+// Approximate nearest-neighbour index over face embeddings (HNSW: a stack of
+// proximity graphs, sparser towards the top). A query descends greedily
+// through the upper layers and then runs a best-first search of width `ef`
+// on the bottom layer, so it touches a few hundred rows instead of the whole
+// gallery. Larger `ef` trades latency for recall.
+//
+// On-disk layout (magic "HNSW"), read back into memory by load():
+//   HNSWHeader
+//   float    vectors[count][FACE_EMBEDDING_DIM]   as stored (unit-length under cosine)
+//   int32_t  studentIds[count]
+//   uint8_t  levels[count]                   zero-padded to a multiple of 4
+//   uint32_t level0[count][1 + 2 * M]        neighbour count, then neighbours
+//   uint32_t upperOffsets[count + 1]         start of each node's upper links
+//   uint32_t upper[upperWords]               levels 1..L, (1 + M) words each
+
+inline constexpr uint32_t HNSW_VERSION = 1;
+
+struct HNSWHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t metric;  // 0 = L2, 1 = cosine
+    uint32_t dimension;
+    uint32_t count;
+    uint32_t M;
+    uint32_t efConstruction;
+    uint32_t entryPoint;
+    uint32_t maxLevel;
+    uint32_t upperWords;
+};
+
+class HNSWIndex {
+private:
+    using Candidate = pair<float, uint32_t>;  // (score, node); smaller score is closer
+
+    EmbeddingMatrix vectors;
+    vector<int> studentIds;
+    vector<uint8_t> levels;
+    vector<uint32_t> level0;          // fixed (1 + maxM0) words per node
+    vector<vector<uint32_t>> upper;   // per node, (1 + M) words per level above 0
+    uint32_t M;
+    uint32_t maxM0;
+    uint32_t efConstruction;
+    uint32_t entryPoint;
+    int maxLevel;                     // -1 while empty
+    mt19937 rng;
+
+    // Visited marks for searchLayer; an epoch counter avoids clearing them.
+    // Each concurrent search needs its own set.
+    struct VisitedMarks {
+        vector<uint32_t> marks;
+        uint32_t epoch = 0;
+
+        uint32_t next(size_t count) {
+            if (marks.size() < count) marks.resize(count, 0);
+            if (++epoch == 0) {
+                fill(marks.begin(), marks.end(), 0);
+                epoch = 1;
+            }
+            return epoch;
+        }
+    };
+
+    // Marks for insert() and the single-query search(), one set per thread so
+    // searches can run concurrently (inserts still need exclusive access).
+    static VisitedMarks& threadMarks() {
+        thread_local VisitedMarks marks;
+        return marks;
+    }
+
+    static constexpr int MAX_LEVEL = 16;
+
+    uint32_t* linksOf(uint32_t node, int level) {
+        if (level == 0) return level0.data() + size_t(node) * (1 + maxM0);
+        return upper[node].data() + size_t(level - 1) * (1 + M);
+    }
+
+    const uint32_t* linksOf(uint32_t node, int level) const {
+        return const_cast<HNSWIndex*>(this)->linksOf(node, level);
+    }
+
+    int randomLevel() {
+        // Geometric with ratio 1/M, as in the HNSW paper (mL = 1 / ln M).
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        double u = max(unit(rng), 1e-12);
+        return min(static_cast<int>(-log(u) / log(double(M))), MAX_LEVEL);
+    }
+
+    // Greedy walk on one layer: moves to a closer neighbour until none is.
+    uint32_t greedyClosest(const float* probe, uint32_t current, int level) const {
+        float currentScore = vectors.score(probe, current);
+        for (bool moved = true; moved;) {
+            moved = false;
+            const uint32_t* links = linksOf(current, level);
+            for (uint32_t i = 1; i <= links[0]; ++i) {
+                float score = vectors.score(probe, links[i]);
+                if (score < currentScore) {
+                    currentScore = score;
+                    current = links[i];
+                    moved = true;
+                }
+            }
+        }
+        return current;
+    }
+
+    // Best-first search of width `ef` on one layer; closest first.
+    vector<Candidate> searchLayer(const float* probe, uint32_t entry, size_t ef, int level,
+                                  VisitedMarks& visited) const {
+        uint32_t epoch = visited.next(studentIds.size());
+        priority_queue<Candidate, vector<Candidate>, greater<Candidate>> frontier;
+        priority_queue<Candidate> best;  // farthest of the kept results on top
+        float entryScore = vectors.score(probe, entry);
+        frontier.push({entryScore, entry});
+        best.push({entryScore, entry});
+        visited.marks[entry] = epoch;
+
+        while (!frontier.empty()) {
+            Candidate closest = frontier.top();
+            if (closest.first > best.top().first && best.size() >= ef) break;
+            frontier.pop();
+            const uint32_t* links = linksOf(closest.second, level);
+            for (uint32_t i = 1; i <= links[0]; ++i) {
+                uint32_t neighbour = links[i];
+                if (visited.marks[neighbour] == epoch) continue;
+                visited.marks[neighbour] = epoch;
+                float score = vectors.score(probe, neighbour);
+                if (best.size() < ef || score < best.top().first) {
+                    frontier.push({score, neighbour});
+                    best.push({score, neighbour});
+                    if (best.size() > ef) best.pop();
+                }
+            }
+        }
+
+        vector<Candidate> result(best.size());
+        for (size_t i = result.size(); i-- > 0; best.pop()) result[i] = best.top();
+        return result;
+    }
+
+    // Neighbour selection heuristic: keep a candidate only if it is closer to
+    // the base than to every neighbour already kept, which spreads links
+    // across directions instead of clustering them. `candidates` is sorted
+    // closest first.
+    vector<uint32_t> selectNeighbours(const vector<Candidate>& candidates, uint32_t limit) const {
+        vector<uint32_t> kept;
+        for (const auto& [score, node] : candidates) {
+            if (kept.size() == limit) break;
+            bool diverse = true;
+            for (uint32_t other : kept) {
+                if (vectors.score(vectors.row(node), other) < score) {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse) kept.push_back(node);
+        }
+        return kept;
+    }
+
+    // Adds `node` to the links of `neighbour`, re-running the heuristic when
+    // the list is full.
+    void linkBack(uint32_t neighbour, uint32_t node, int level) {
+        uint32_t capacity = level == 0 ? maxM0 : M;
+        uint32_t* links = linksOf(neighbour, level);
+        if (links[0] < capacity) {
+            links[++links[0]] = node;
+            return;
+        }
+        const float* base = vectors.row(neighbour);
+        vector<Candidate> candidates = {{vectors.score(base, node), node}};
+        for (uint32_t i = 1; i <= links[0]; ++i) {
+            candidates.push_back({vectors.score(base, links[i]), links[i]});
+        }
+        sort(candidates.begin(), candidates.end());
+        vector<uint32_t> kept = selectNeighbours(candidates, capacity);
+        links[0] = static_cast<uint32_t>(kept.size());
+        copy(kept.begin(), kept.end(), links + 1);
+    }
+
+    vector<pair<float, int>> search(const float* query, size_t k, size_t ef, VisitedMarks& marks) const {
+        vector<pair<float, int>> result;
+        alignas(64) float probe[FACE_EMBEDDING_DIM];
+        if (maxLevel < 0 || k == 0 || !vectors.prepare(query, probe)) return result;
+
+        uint32_t current = entryPoint;
+        for (int l = maxLevel; l > 0; --l) {
+            current = greedyClosest(probe, current, l);
+        }
+        vector<Candidate> candidates = searchLayer(probe, current, max(ef, k), 0, marks);
+        for (size_t i = 0; i < candidates.size() && i < k; ++i) {
+            result.push_back({vectors.distanceOf(candidates[i].first), studentIds[candidates[i].second]});
+        }
+        return result;
+    }
+
+public:
+    explicit HNSWIndex(FaceMetric metric = FaceMetric::L2, uint32_t m = 16, uint32_t efBuild = 200)
+        : vectors(metric), M(max<uint32_t>(m, 2)), maxM0(2 * max<uint32_t>(m, 2)),
+          efConstruction(max<uint32_t>(efBuild, 1)), entryPoint(0), maxLevel(-1), rng(42) {}
+
+    FaceMetric getMetric() const { return vectors.getMetric(); }
+    size_t size() const { return studentIds.size(); }
+    uint32_t getM() const { return M; }
+    uint32_t getEfConstruction() const { return efConstruction; }
+
+    // Search width used when none is given; override with ATTENDANCE_ANN_EF.
+    static size_t configuredEf() {
+        const char* configured = getenv("ATTENDANCE_ANN_EF");
+        if (configured) {
+            long value = strtol(configured, nullptr, 10);
+            if (value > 0) return static_cast<size_t>(value);
+        }
+        return 64;
+    }
+
+    void reserve(size_t count) {
+        vectors.reserve(count);
+        studentIds.reserve(count);
+        levels.reserve(count);
+        level0.reserve(count * (1 + maxM0));
+        upper.reserve(count);
+    }
+
+    // Enrolls one embedding; false if it is rejected (see EmbeddingMatrix).
+    bool insert(int studentId, const float* embedding) {
+        if (studentIds.size() >= UINT32_MAX - 1 || !vectors.append(embedding)) return false;
+        uint32_t node = static_cast<uint32_t>(studentIds.size());
+        int level = randomLevel();
+        studentIds.push_back(studentId);
+        levels.push_back(static_cast<uint8_t>(level));
+        level0.resize(level0.size() + 1 + maxM0, 0);
+        upper.emplace_back(size_t(level) * (1 + M), 0);
+
+        if (maxLevel < 0) {
+            entryPoint = node;
+            maxLevel = level;
+            return true;
+        }
+
+        const float* probe = vectors.row(node);
+        uint32_t current = entryPoint;
+        for (int l = maxLevel; l > level; --l) {
+            current = greedyClosest(probe, current, l);
+        }
+        for (int l = min(level, maxLevel); l >= 0; --l) {
+            vector<Candidate> candidates = searchLayer(probe, current, efConstruction, l, threadMarks());
+            vector<uint32_t> neighbours = selectNeighbours(candidates, M);
+            uint32_t* links = linksOf(node, l);
+            links[0] = static_cast<uint32_t>(neighbours.size());
+            copy(neighbours.begin(), neighbours.end(), links + 1);
+            for (uint32_t neighbour : neighbours) {
+                linkBack(neighbour, node, l);
+            }
+            current = candidates.front().second;
+        }
+        if (level > maxLevel) {
+            entryPoint = node;
+            maxLevel = level;
+        }
+        return true;
+    }
+
+    // Up to k nearest entries to `query` as (distance, student ID), closest
+    // first, searching with width max(ef, k).
+    vector<pair<float, int>> search(const float* query, size_t k, size_t ef) const {
+        return search(query, k, ef, threadMarks());
+    }
+
+    // Same contract as FaceMatcher::match, answered approximately.
+    int match(const float* query, float threshold, size_t ef, float* distance = nullptr) const {
+        vector<pair<float, int>> nearest = search(query, 1, ef);
+        if (nearest.empty()) return -1;
+        if (distance) *distance = nearest[0].first;
+        return nearest[0].first <= threshold ? nearest[0].second : -1;
+    }
+
+    // Batch form of match(): queries are consecutive FACE_EMBEDDING_DIM
+    // floats, searched in parallel with one set of visited marks per thread.
+    vector<FaceMatch> matchBatch(const float* queries, size_t count, float threshold, size_t ef,
+                                 size_t threads = matchThreadCount()) const {
+        vector<FaceMatch> result(count, {-1, numeric_limits<float>::infinity()});
+        parallelChunks(count, threads, [&](size_t, size_t begin, size_t end) {
+            VisitedMarks marks;
+            for (size_t q = begin; q < end; ++q) {
+                vector<pair<float, int>> nearest = search(queries + q * FACE_EMBEDDING_DIM, 1, ef, marks);
+                if (nearest.empty()) continue;
+                result[q] = {nearest[0].first <= threshold ? nearest[0].second : -1, nearest[0].first};
+            }
+        });
+        return result;
+    }
+
+    // Writes the index atomically (see the layout above).
+    bool save(const string& filename) const {
+        vector<uint32_t> upperOffsets = {0};
+        vector<uint32_t> upperWords;
+        for (const auto& links : upper) {
+            upperWords.insert(upperWords.end(), links.begin(), links.end());
+            upperOffsets.push_back(static_cast<uint32_t>(upperWords.size()));
+        }
+
+        HNSWHeader header = {{'H', 'N', 'S', 'W'}, HNSW_VERSION,
+                             getMetric() == FaceMetric::L2 ? 0u : 1u,
+                             static_cast<uint32_t>(FACE_EMBEDDING_DIM),
+                             static_cast<uint32_t>(studentIds.size()), M, efConstruction,
+                             entryPoint, static_cast<uint32_t>(max(maxLevel, 0)),
+                             static_cast<uint32_t>(upperWords.size())};
+        vector<char> contents;
+        appendRecord(contents, header);
+        for (size_t i = 0; i < studentIds.size(); ++i) {
+            const char* row = reinterpret_cast<const char*>(vectors.row(i));
+            contents.insert(contents.end(), row, row + FACE_EMBEDDING_DIM * sizeof(float));
+        }
+        appendRecords(contents, studentIds);
+        appendPaddedBytes(contents, string(levels.begin(), levels.end()));
+        appendRecords(contents, level0);
+        appendRecords(contents, upperOffsets);
+        appendRecords(contents, upperWords);
+        return writeFileAtomically(filename, contents);
+    }
+
+    // Replaces this index with one written by save(); fails on missing or
+    // malformed files.
+    bool load(const string& filename) {
+        ifstream inFile(filename, ios::binary);
+        if (!inFile) return false;
+        vector<char> bytes((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
+        HNSWHeader header;
+        if (bytes.size() < sizeof(header) || !hasFlatMagic(bytes.data(), bytes.size(), "HNSW")) return false;
+        memcpy(&header, bytes.data(), sizeof(header));
+        if (header.version != HNSW_VERSION || header.metric > 1 || header.dimension != FACE_EMBEDDING_DIM ||
+            header.M < 2) return false;
+
+        uint64_t count = header.count, m0 = 2ull * header.M;
+        uint64_t needed = sizeof(header) + count * FACE_EMBEDDING_DIM * sizeof(float) + count * sizeof(int32_t) +
+                          paddedTo4(count) + count * (1 + m0) * sizeof(uint32_t) +
+                          (count + 1) * sizeof(uint32_t) + uint64_t(header.upperWords) * sizeof(uint32_t);
+        if (needed != bytes.size() || (count > 0 && header.entryPoint >= count)) return false;
+
+        HNSWIndex loaded(header.metric == 0 ? FaceMetric::L2 : FaceMetric::Cosine, header.M, header.efConstruction);
+        const char* cursor = bytes.data() + sizeof(header);
+        const float* rows = reinterpret_cast<const float*>(cursor);
+        cursor += count * FACE_EMBEDDING_DIM * sizeof(float);
+        const int32_t* ids = reinterpret_cast<const int32_t*>(cursor);
+        cursor += count * sizeof(int32_t);
+        const uint8_t* nodeLevels = reinterpret_cast<const uint8_t*>(cursor);
+        cursor += paddedTo4(count);
+        const uint32_t* links0 = reinterpret_cast<const uint32_t*>(cursor);
+        cursor += count * (1 + m0) * sizeof(uint32_t);
+        const uint32_t* upperOffsets = reinterpret_cast<const uint32_t*>(cursor);
+        const uint32_t* upperWords = upperOffsets + count + 1;
+
+        loaded.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            // Stored rows are already prepared; appending them again revalidates them.
+            if (!loaded.vectors.append(rows + i * FACE_EMBEDDING_DIM) || nodeLevels[i] > MAX_LEVEL ||
+                upperOffsets[i + 1] < upperOffsets[i] || upperOffsets[i + 1] > header.upperWords ||
+                upperOffsets[i + 1] - upperOffsets[i] != uint64_t(nodeLevels[i]) * (1 + header.M)) return false;
+            loaded.studentIds.push_back(ids[i]);
+            loaded.levels.push_back(nodeLevels[i]);
+            loaded.upper.emplace_back(upperWords + upperOffsets[i], upperWords + upperOffsets[i + 1]);
+        }
+        loaded.level0.assign(links0, links0 + count * (1 + m0));
+
+        // Every neighbour list must fit its slot and point at a real node.
+        for (uint32_t node = 0; node < count; ++node) {
+            for (int l = 0; l <= loaded.levels[node]; ++l) {
+                const uint32_t* links = loaded.linksOf(node, l);
+                if (links[0] > (l == 0 ? m0 : header.M)) return false;
+                for (uint32_t i = 1; i <= links[0]; ++i) {
+                    if (links[i] >= count || loaded.levels[links[i]] < l) return false;
+                }
+            }
+        }
+        loaded.entryPoint = header.entryPoint;
+        loaded.maxLevel = count == 0 ? -1 : static_cast<int>(loaded.levels[header.entryPoint]);
+        *this = move(loaded);
+        return true;
+    }
+};
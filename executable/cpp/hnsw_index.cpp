@@ -0,0 +1,219 @@
+#include "hnsw.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+using namespace std;
+
+// Builds, extends and evaluates the approximate face index.
+//
+//   hnsw_index build  [--metric l2|cosine] [--M 16] [--ef-construction 200] [--students <csv>] <index_file>
+//   hnsw_index insert <index_file> <student_id> < embedding.bin
+//   hnsw_index recall [--ef 16,32,64,128] [--queries 1000] [--noise 0.02] [--students <csv>] <index_file>
+//
+// recall perturbs gallery embeddings from the CSV with Gaussian noise, asks
+// both the index and the exact matcher, and reports recall@1 (same nearest
+// student) and answer agreement (same student ID or -1 at the configured
+// threshold) together with per-query latency, for each ef.
+
+static const char* USAGE =
+    "Usage: hnsw_index build  [--metric l2|cosine] [--M 16] [--ef-construction 200] [--students <csv>] <index_file>\n"
+    "       hnsw_index insert <index_file> <student_id> < embedding.bin\n"
+    "       hnsw_index recall [--ef 16,32,64,128] [--queries 1000] [--noise 0.02] [--students <csv>] <index_file>\n";
+
+// Splits "--name value" pairs ahead of the positional arguments.
+static bool parseOptions(int argc, char* argv[], int first, map<string, string>& options, vector<string>& positional) {
+    for (int i = first; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) == 0) {
+            if (i + 1 >= argc) return false;
+            options[arg] = argv[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    return true;
+}
+
+static bool parsePositive(const string& text, long& value) {
+    try {
+        size_t used;
+        value = stol(text, &used);
+        return used == text.size() && value > 0;
+    } catch (const exception&) {
+        return false;
+    }
+}
+
+static double percentile(vector<double> samples, double fraction) {
+    if (samples.empty()) return 0.0;
+    sort(samples.begin(), samples.end());
+    return samples[min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))];
+}
+
+static int runBuild(const map<string, string>& options, const string& indexFilename, const string& studentsFilename) {
+    FaceMetric metric = FaceMatcher::configuredMetric();
+    long m = 16, efConstruction = 200;
+    if ((options.count("--metric") && !FaceMatcher::parseMetric(options.at("--metric"), metric)) ||
+        (options.count("--M") && !parsePositive(options.at("--M"), m)) ||
+        (options.count("--ef-construction") && !parsePositive(options.at("--ef-construction"), efConstruction))) {
+        cerr << USAGE;
+        return 1;
+    }
+
+    HNSWIndex index(metric, static_cast<uint32_t>(m), static_cast<uint32_t>(efConstruction));
+    size_t skipped = 0;
+    auto start = chrono::steady_clock::now();
+    bool opened = forEachFaceEmbedding(studentsFilename,
+        [&](int studentId, const float* embedding) { return index.insert(studentId, embedding); }, &skipped);
+    if (!opened) {
+        cerr << "Error opening CSV file: " << studentsFilename << endl;
+        return 1;
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    if (skipped > 0) {
+        cerr << "Warning: skipped " << skipped << " rows without a valid facial_vector" << endl;
+    }
+    if (!index.save(indexFilename)) {
+        cerr << "Error: Failed to write " << indexFilename << endl;
+        return 1;
+    }
+    cout << "Indexed " << index.size() << " faces into " << indexFilename << " in " << elapsed.count() << "s" << endl;
+    return 0;
+}
+
+static int runInsert(const string& indexFilename, const string& studentIdText) {
+    long studentId;
+    if (!parsePositive(studentIdText, studentId)) {
+        cerr << USAGE;
+        return 1;
+    }
+    HNSWIndex index;
+    if (!index.load(indexFilename)) {
+        cerr << "Error: Failed to load " << indexFilename << endl;
+        return 1;
+    }
+    vector<float> embedding(FACE_EMBEDDING_DIM);
+    if (fread(embedding.data(), sizeof(float), FACE_EMBEDDING_DIM, stdin) != FACE_EMBEDDING_DIM) {
+        cerr << "Error: expected " << FACE_EMBEDDING_DIM * sizeof(float) << "-byte embedding on stdin" << endl;
+        return 1;
+    }
+    if (!index.insert(static_cast<int>(studentId), embedding.data()) || !index.save(indexFilename)) {
+        cerr << "Error: Failed to insert student ID " << studentId << " into " << indexFilename << endl;
+        return 1;
+    }
+    cout << "Inserted student ID " << studentId << " (" << index.size() << " faces)" << endl;
+    return 0;
+}
+
+static int runRecall(const map<string, string>& options, const string& indexFilename, const string& studentsFilename) {
+    long queryCount = 1000;
+    double noise = 0.02;
+    vector<size_t> efs;
+    string efList = options.count("--ef") ? options.at("--ef") : "16,32,64,128";
+    try {
+        if (options.count("--queries") && !parsePositive(options.at("--queries"), queryCount)) throw invalid_argument("queries");
+        if (options.count("--noise")) noise = stod(options.at("--noise"));
+        for (size_t start = 0; start <= efList.size();) {
+            size_t comma = min(efList.find(',', start), efList.size());
+            long ef;
+            if (!parsePositive(efList.substr(start, comma - start), ef)) throw invalid_argument("ef");
+            efs.push_back(static_cast<size_t>(ef));
+            start = comma + 1;
+        }
+    } catch (const exception&) {
+        cerr << USAGE;
+        return 1;
+    }
+
+    HNSWIndex index;
+    if (!index.load(indexFilename)) {
+        cerr << "Error: Failed to load " << indexFilename << endl;
+        return 1;
+    }
+    FaceMatcher exact(index.getMetric());
+    vector<vector<float>> gallery;
+    bool opened = forEachFaceEmbedding(studentsFilename, [&](int studentId, const float* embedding) {
+        gallery.emplace_back(embedding, embedding + FACE_EMBEDDING_DIM);
+        return exact.add(studentId, embedding);
+    });
+    if (!opened || gallery.empty()) {
+        cerr << "Error: no embeddings in " << studentsFilename << endl;
+        return 1;
+    }
+
+    mt19937 rng(7);
+    normal_distribution<float> jitter(0.0f, static_cast<float>(noise));
+    uniform_int_distribution<size_t> pick(0, gallery.size() - 1);
+    vector<vector<float>> queries;
+    for (long i = 0; i < queryCount; ++i) {
+        vector<float> query = gallery[pick(rng)];
+        for (float& value : query) value += jitter(rng);
+        queries.push_back(move(query));
+    }
+
+    const float threshold = FaceMatcher::configuredThreshold(index.getMetric());
+    auto millisSince = [](chrono::steady_clock::time_point start) {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+
+    vector<int> exactNearest, exactAnswers;
+    vector<double> exactLatency;
+    for (const auto& query : queries) {
+        auto start = chrono::steady_clock::now();
+        int answer = exact.match(query.data(), threshold);
+        exactLatency.push_back(millisSince(start));
+        exactAnswers.push_back(answer);
+        exactNearest.push_back(exact.match(query.data(), numeric_limits<float>::infinity()));
+    }
+
+    printf("%zu faces, %ld queries, noise %.3f, threshold %.3f, kernel %s\n",
+           index.size(), queryCount, noise, threshold, FaceMatcher::kernelName());
+    printf("%-8s %10s %10s %12s %12s %9s\n", "ef", "recall@1", "agreement", "p50 ms", "p99 ms", "speedup");
+    printf("%-8s %10.4f %10.4f %12.4f %12.4f %8.2fx\n", "exact", 1.0, 1.0,
+           percentile(exactLatency, 0.5), percentile(exactLatency, 0.99), 1.0);
+    for (size_t ef : efs) {
+        size_t hits = 0, agreed = 0;
+        vector<double> latency;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            auto start = chrono::steady_clock::now();
+            int answer = index.match(queries[i].data(), threshold, ef);
+            latency.push_back(millisSince(start));
+            agreed += answer == exactAnswers[i];
+            vector<pair<float, int>> nearest = index.search(queries[i].data(), 1, ef);
+            hits += !nearest.empty() && nearest[0].second == exactNearest[i];
+        }
+        printf("%-8zu %10.4f %10.4f %12.4f %12.4f %8.2fx\n", ef,
+               double(hits) / queries.size(), double(agreed) / queries.size(),
+               percentile(latency, 0.5), percentile(latency, 0.99),
+               percentile(exactLatency, 0.5) / max(percentile(latency, 0.5), 1e-9));
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << USAGE;
+        return 1;
+    }
+    const string mode = argv[1];
+    map<string, string> options;
+    vector<string> positional;
+    if (!parseOptions(argc, argv, 2, options, positional)) {
+        cerr << USAGE;
+        return 1;
+    }
+    const string studentsFilename = options.count("--students") ? options["--students"] : "../data/students.csv";
+
+    if (mode == "build" && positional.size() == 1) return runBuild(options, positional[0], studentsFilename);
+    if (mode == "insert" && positional.size() == 2 && options.empty()) return runInsert(positional[0], positional[1]);
+    if (mode == "recall" && positional.size() == 1) return runRecall(options, positional[0], studentsFilename);
+    cerr << USAGE;
+    return 1;
+}
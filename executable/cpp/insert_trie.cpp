@@ -1,6 +1,5 @@
-#include "trie.h"
+#include "token_index.h"
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
 
@@ -8,31 +7,71 @@ using namespace std;
 
 // Trie class definition and core methods are now provided by trie.h
 
+// Batch mode: every input record is "<student_name>,<student_id>" (quote
+// names that contain commas). All records go into one in-memory trie that is
+// serialized once.
+static size_t insertBatch(CSVReader& input, Trie& trie, Trie& tokens) {
+    size_t inserted = 0;
+    while (input.next()) {
+        int studentId;
+        if (input.size() != 2 || input[0].empty() || !parseCSVInt(input[1], studentId)) {
+            cerr << "Skipping invalid input line " << input.line() << endl;
+            continue;
+        }
+        trie.insert(string(input[0]), studentId);
+        insertNameTokens(tokens, input[0], studentId);
+        ++inserted;
+    }
+    return inserted;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
+    MetricsReport metrics("insert_trie", argc, argv);
+    const bool batch = argc >= 2 && string(argv[1]) == "--batch";
+    int studentId = 0;
+    if ((batch && argc > 3) || (!batch && (argc != 3 || !parseCSVInt(argv[2], studentId)))) {
         cerr << "Usage: " << argv[0] << " <student_name> <student_id>" << endl;
+        cerr << "       " << argv[0] << " --batch [input_file]   (lines: <student_name>,<student_id>)" << endl;
         return 1;
     }
 
-    const string name = argv[1];
-    const string studentId = argv[2];
-    
     // Corrected path to the data file
-    const string trieFilename = "../serialized/name.dat"; 
-    
+    const string trieFilename = "../serialized/name.dat";
+    const string tokensFilename = tokenIndexFile(trieFilename);
+
     Trie trie;
-    
+
     // Load the existing trie
     if (!trie.deserialize(trieFilename)) {
         // If deserialize fails (file doesn't exist yet), start with an empty tree.
         cerr << "Warning: Data file not found. Starting with a new Trie." << endl;
     }
-    
-    // Insert the new name and student ID
-    trie.insert(name, studentId);
-    
+    // The token index (token_index.h) follows the names; rebuild it from
+    // them if it was never written
+    Trie tokens;
+    if (!tokens.deserialize(tokensFilename)) tokens = buildTokenIndex(trie);
+
+    if (batch) {
+        CSVReader input;
+        if (argc == 3 && string(argv[2]) != "-") {
+            if (!input.open(argv[2])) {
+                cerr << "Error opening batch file: " << argv[2] << endl;
+                return 1;
+            }
+        } else if (!input.read(stdin)) {
+            cerr << "Error reading the batch from stdin" << endl;
+            return 1;
+        }
+        size_t inserted = insertBatch(input, trie, tokens);
+        cout << "Inserted " << inserted << " names into " << trieFilename << endl;
+    } else {
+        // Insert the new name and student ID
+        trie.insert(argv[1], studentId);
+        insertNameTokens(tokens, argv[1], studentId);
+    }
+
     // Serialize the updated trie
-    if (trie.serialize(trieFilename)) {
+    if (trie.serialize(trieFilename) && tokens.serialize(tokensFilename)) {
         return 0; // Success (Python process relies on a clean exit)
     } else {
         return 1; // Failure
@@ -0,0 +1,194 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Opt-in hot-path instrumentation shared by the tools and the engine.
+// Counters (tree nodes visited, AVL rotations, bytes read, written and
+// mapped) and per-phase wall time are compiled in everywhere but only
+// collected when ATTENDANCE_METRICS is set or a tool gets --metrics; when
+// off, every probe is one predictable branch on a plain bool.
+//
+// A tool prints one JSON line per invocation when it exits (see MetricsReport):
+//   {"tool":"threshold","wall_us":812.4,"counters":{"nodes_visited":9,...},
+//    "phases":{"deserialize":{"calls":1,"us":301.2},...}}
+// to stderr for ATTENDANCE_METRICS=1 (or --metrics), or appended to the file
+// ATTENDANCE_METRICS names otherwise. The engine exposes the same counters
+// in Prometheus text format through its METRICS command.
+
+enum class Counter { NodesVisited, Rotations, BytesRead, BytesWritten, BytesMapped, Count };
+
+// Phases are timed inclusively: a compaction's deserialize also counts
+// towards the update that triggered it.
+enum class Phase { Build, Insert, Update, Query, Serialize, Deserialize, LogAppend, TrieInsert, TrieSearch, Count };
+
+class Metrics {
+private:
+    static constexpr size_t COUNTERS = static_cast<size_t>(Counter::Count);
+    static constexpr size_t PHASES = static_cast<size_t>(Phase::Count);
+
+    bool enabled;
+    string destination;  // "" for stderr, else a file to append to
+    chrono::steady_clock::time_point started;
+    atomic<uint64_t> counters[COUNTERS];
+    atomic<uint64_t> phaseCalls[PHASES];
+    atomic<uint64_t> phaseNanos[PHASES];
+
+    Metrics() : enabled(false), started(chrono::steady_clock::now()) {
+        for (auto& counter : counters) counter.store(0, memory_order_relaxed);
+        for (size_t p = 0; p < PHASES; ++p) {
+            phaseCalls[p].store(0, memory_order_relaxed);
+            phaseNanos[p].store(0, memory_order_relaxed);
+        }
+        const char* configured = getenv("ATTENDANCE_METRICS");
+        if (configured && *configured && strcmp(configured, "0") != 0) {
+            enabled = true;
+            if (strcmp(configured, "1") != 0 && strcmp(configured, "stderr") != 0) destination = configured;
+        }
+    }
+
+public:
+    static const char* counterName(size_t counter) {
+        static const char* const names[COUNTERS] = {"nodes_visited", "rotations", "bytes_read", "bytes_written",
+                                                    "bytes_mapped"};
+        return names[counter];
+    }
+
+    static const char* phaseName(size_t phase) {
+        static const char* const names[PHASES] = {"build", "insert", "update", "query", "serialize",
+                                                  "deserialize", "log_append", "trie_insert", "trie_search"};
+        return names[phase];
+    }
+
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    static bool on() {
+        return instance().enabled;
+    }
+
+    static void enable() {
+        instance().enabled = true;
+    }
+
+    static void add(Counter counter, uint64_t amount = 1) {
+        Metrics& metrics = instance();
+        if (metrics.enabled) metrics.counters[static_cast<size_t>(counter)].fetch_add(amount, memory_order_relaxed);
+    }
+
+    static void record(Phase phase, uint64_t nanos) {
+        Metrics& metrics = instance();
+        metrics.phaseCalls[static_cast<size_t>(phase)].fetch_add(1, memory_order_relaxed);
+        metrics.phaseNanos[static_cast<size_t>(phase)].fetch_add(nanos, memory_order_relaxed);
+    }
+
+    // {"tool":...,"wall_us":...,"counters":{...},"phases":{...}}; phases
+    // that never ran are left out.
+    string json(const string& tool) const {
+        char number[64];
+        snprintf(number, sizeof(number), "%.1f",
+                 chrono::duration<double, micro>(chrono::steady_clock::now() - started).count());
+        string line = "{\"tool\":\"" + tool + "\",\"wall_us\":" + number + ",\"counters\":{";
+        for (size_t c = 0; c < COUNTERS; ++c) {
+            if (c > 0) line += ',';
+            line += string("\"") + counterName(c) + "\":" + to_string(counters[c].load(memory_order_relaxed));
+        }
+        line += "},\"phases\":{";
+        bool first = true;
+        for (size_t p = 0; p < PHASES; ++p) {
+            uint64_t calls = phaseCalls[p].load(memory_order_relaxed);
+            if (calls == 0) continue;
+            snprintf(number, sizeof(number), "%.1f", phaseNanos[p].load(memory_order_relaxed) / 1000.0);
+            line += string(first ? "" : ",") + "\"" + phaseName(p) + "\":{\"calls\":" + to_string(calls) +
+                    ",\"us\":" + number + "}";
+            first = false;
+        }
+        return line + "}}";
+    }
+
+    // Prometheus text exposition, one sample per line.
+    vector<string> prometheus() const {
+        vector<string> lines;
+        for (size_t c = 0; c < COUNTERS; ++c) {
+            const string name = string("attendance_") + counterName(c) + "_total";
+            lines.push_back("# TYPE " + name + " counter");
+            lines.push_back(name + " " + to_string(counters[c].load(memory_order_relaxed)));
+        }
+        lines.push_back("# TYPE attendance_phase_calls_total counter");
+        for (size_t p = 0; p < PHASES; ++p) {
+            lines.push_back(string("attendance_phase_calls_total{phase=\"") + phaseName(p) + "\"} " +
+                            to_string(phaseCalls[p].load(memory_order_relaxed)));
+        }
+        lines.push_back("# TYPE attendance_phase_seconds_total counter");
+        char number[64];
+        for (size_t p = 0; p < PHASES; ++p) {
+            snprintf(number, sizeof(number), "%.9f", phaseNanos[p].load(memory_order_relaxed) / 1e9);
+            lines.push_back(string("attendance_phase_seconds_total{phase=\"") + phaseName(p) + "\"} " + number);
+        }
+        return lines;
+    }
+
+    // Writes the JSON line to stderr or appends it to the configured file.
+    void emit(const string& tool) const {
+        const string line = json(tool) + "\n";
+        FILE* out = destination.empty() ? stderr : fopen(destination.c_str(), "a");
+        if (!out) return;
+        fputs(line.c_str(), out);
+        if (out != stderr) fclose(out);
+    }
+};
+
+// Created during static initialization, so wall_us covers main() and the
+// static constructors that follow this header.
+inline Metrics& metricsAtStartup = Metrics::instance();
+
+// Adds the enclosing scope's wall time to a phase (no clock reads when off).
+class ScopedTimer {
+private:
+    Phase phase;
+    bool active;
+    chrono::steady_clock::time_point started;
+
+public:
+    explicit ScopedTimer(Phase timedPhase) : phase(timedPhase), active(Metrics::on()) {
+        if (active) started = chrono::steady_clock::now();
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ~ScopedTimer() {
+        if (!active) return;
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started);
+        Metrics::record(phase, static_cast<uint64_t>(elapsed.count()));
+    }
+};
+
+// Declared at the top of a tool's main(): strips "--metrics" (which turns
+// collection on) and emits the JSON line when main returns.
+class MetricsReport {
+private:
+    string tool;
+
+public:
+    MetricsReport(const string& toolName, int& argc, char* argv[]) : tool(toolName) {
+        int kept = 1;
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], "--metrics") == 0) Metrics::enable();
+            else argv[kept++] = argv[i];
+        }
+        argc = kept;
+    }
+    MetricsReport(const MetricsReport&) = delete;
+    MetricsReport& operator=(const MetricsReport&) = delete;
+    ~MetricsReport() {
+        if (Metrics::on()) Metrics::instance().emit(tool);
+    }
+};
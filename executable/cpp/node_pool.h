@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+// Link value for "no child"
+inline constexpr int32_t NULL_NODE = -1;
+
+// Index-addressed node pool used by AVLTree and Trie.
+// Nodes live contiguously in one vector and point at each other with 32-bit
+// indices, so traversals touch no reference counts and the whole structure is
+// freed in one go. Released slots are recycled through a free list.
+// Indices stay valid across allocations; references do not.
+template <typename Node>
+class NodePool {
+private:
+    vector<Node> nodes;
+    vector<int32_t> freeList;
+
+public:
+    template <typename... Args>
+    int32_t allocate(Args&&... args) {
+        if (!freeList.empty()) {
+            int32_t index = freeList.back();
+            freeList.pop_back();
+            nodes[index] = Node(forward<Args>(args)...);
+            return index;
+        }
+        nodes.emplace_back(forward<Args>(args)...);
+        return static_cast<int32_t>(nodes.size() - 1);
+    }
+
+    void release(int32_t index) {
+        nodes[index] = Node();
+        freeList.push_back(index);
+    }
+
+    Node& operator[](int32_t index) { return nodes[index]; }
+    const Node& operator[](int32_t index) const { return nodes[index]; }
+
+    void reserve(size_t count) { nodes.reserve(count); }
+
+    void clear() {
+        nodes.clear();
+        freeList.clear();
+    }
+
+    // Live nodes (allocated and not released)
+    size_t size() const { return nodes.size() - freeList.size(); }
+};
@@ -0,0 +1,461 @@
+#pragma once
+#include "flat_format.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Compressed student ID lists shared by the AVL, bucket and Trie indexes.
+//
+// PostingList is the in-memory form: a sorted set of int32 IDs cut into
+// blocks of up to 2 * BLOCK IDs. A block keeps its first and last ID
+// uncompressed, and each ID as its offset from the first, at the narrowest
+// of 1, 2 or 4 bytes that holds the block's span. The offsets are
+// independent of each other, so decoding a block is one vectorized
+// widen-and-add with no branch on the data (a varint or gap walk is a serial
+// chain), and a block can be binary-searched without decoding it. The
+// blocks' first IDs form the skip table, so a membership test, insert or
+// erase binary-searches the blocks and then a single block: O(log n + BLOCK)
+// counting the byte shift of an insert. Each block also records how many IDs
+// precede it, so at(k) binary-searches those counts the same way; an insert
+// or erase bumps the counts of the blocks after its own, which is free when
+// IDs arrive in ascending order. Offsets are taken in uint32 arithmetic, so
+// negative IDs sort and encode correctly.
+//
+// IdPoolView reads the ID pool of a flat index file in place (see
+// flat_format.h for the compressed layout). It also reads the plain int32
+// and string pools of older files, so callers see numeric IDs either way.
+
+inline void appendVarint(vector<uint8_t>& bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+// Decodes one varint; stops at `end` on truncated input.
+inline uint32_t readVarint(const uint8_t*& p, const uint8_t* end) {
+    if (p < end && *p < 0x80) return *p++;  // most gaps fit one byte
+    uint32_t value = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+        uint8_t byte = *p++;
+        value |= uint32_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+inline uint32_t zigzag(int32_t value) {
+    return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+inline int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+class PostingList {
+public:
+    // IDs per block when a list is built in one go; inserts split a block
+    // once it reaches twice this.
+    static constexpr uint32_t BLOCK = 64;
+
+private:
+    struct Block {
+        int32_t first;
+        int32_t last;
+        uint32_t start;           // IDs in the blocks before this one
+        uint16_t count;
+        uint8_t width;            // bytes per offset: 1, 2 or 4
+        vector<uint8_t> offsets;  // id - first for each of the count IDs
+    };
+
+    vector<Block> blocks;
+    size_t total;
+
+    static uint8_t widthFor(uint32_t span) {
+        return span <= 0xFF ? 1 : span <= 0xFFFF ? 2 : 4;
+    }
+
+    static uint32_t offsetAt(const Block& block, uint32_t i) {
+        const uint8_t* p = block.offsets.data() + size_t(i) * block.width;
+        if (block.width == 1) return *p;
+        if (block.width == 2) {
+            uint16_t offset;
+            memcpy(&offset, p, sizeof(offset));
+            return offset;
+        }
+        uint32_t offset;
+        memcpy(&offset, p, sizeof(offset));
+        return offset;
+    }
+
+    static void writeOffset(uint8_t* p, uint8_t width, uint32_t offset) {
+        if (width == 1) *p = static_cast<uint8_t>(offset);
+        else if (width == 2) {
+            uint16_t narrow = static_cast<uint16_t>(offset);
+            memcpy(p, &narrow, sizeof(narrow));
+        } else {
+            memcpy(p, &offset, sizeof(offset));
+        }
+    }
+
+    static void encode(const int32_t* ids, uint32_t count, Block& block) {
+        block.first = ids[0];
+        block.last = ids[count - 1];
+        block.count = static_cast<uint16_t>(count);
+        block.width = widthFor(uint32_t(block.last) - uint32_t(block.first));
+        block.offsets.resize(size_t(count) * block.width);
+        for (uint32_t i = 0; i < count; ++i) {
+            writeOffset(block.offsets.data() + size_t(i) * block.width, block.width,
+                        uint32_t(ids[i]) - uint32_t(block.first));
+        }
+    }
+
+    template <typename Offset>
+    static void decodeAs(const Block& block, int32_t* out) {
+        const uint8_t* p = block.offsets.data();
+        const uint32_t first = uint32_t(block.first);
+        for (uint32_t i = 0; i < block.count; ++i) {
+            Offset offset;
+            memcpy(&offset, p + size_t(i) * sizeof(Offset), sizeof(Offset));
+            out[i] = static_cast<int32_t>(first + offset);
+        }
+    }
+
+    // Writes the block's IDs to `out` (room for block.count) and returns the
+    // count. Offsets are fixed-width and independent of each other, so the
+    // loop has no branch on the data and the compiler vectorizes it.
+    static uint32_t decode(const Block& block, int32_t* out) {
+        if (block.width == 1) decodeAs<uint8_t>(block, out);
+        else if (block.width == 2) decodeAs<uint16_t>(block, out);
+        else decodeAs<uint32_t>(block, out);
+        return block.count;
+    }
+
+    // Index of the first ID >= id within the block, by binary search on the offsets.
+    static uint32_t lowerBound(const Block& block, int32_t id) {
+        if (id <= block.first) return 0;
+        const uint32_t offset = uint32_t(id) - uint32_t(block.first);
+        uint32_t lo = 0, hi = block.count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (offsetAt(block, mid) < offset) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Last block whose first ID is <= id (block 0 if there is none).
+    size_t blockFor(int32_t id) const {
+        auto after = upper_bound(blocks.begin(), blocks.end(), id,
+                                 [](int32_t value, const Block& block) { return value < block.first; });
+        return after == blocks.begin() ? 0 : after - blocks.begin() - 1;
+    }
+
+    // Keeps start in step after block b gained (+1) or lost (-1) an ID.
+    void shiftStarts(size_t b, int delta) {
+        for (size_t next = b + 1; next < blocks.size(); ++next) blocks[next].start += delta;
+    }
+
+public:
+    PostingList() : total(0) {}
+
+    // From IDs that are already sorted and distinct.
+    template <typename Iterator>
+    void assignSorted(Iterator first, Iterator last) {
+        blocks.clear();
+        total = 0;
+        int32_t buffer[BLOCK];
+        uint32_t filled = 0;
+        for (; first != last; ++first) {
+            buffer[filled++] = *first;
+            if (filled == BLOCK) {
+                encode(buffer, filled, blocks.emplace_back());
+                blocks.back().start = static_cast<uint32_t>(total);
+                total += filled;
+                filled = 0;
+            }
+        }
+        if (filled > 0) {
+            encode(buffer, filled, blocks.emplace_back());
+            blocks.back().start = static_cast<uint32_t>(total);
+            total += filled;
+        }
+    }
+
+    size_t size() const { return total; }
+    bool empty() const { return total == 0; }
+
+    void clear() {
+        blocks.clear();
+        total = 0;
+    }
+
+    bool contains(int32_t id) const {
+        if (blocks.empty()) return false;
+        const Block& block = blocks[blockFor(id)];
+        if (id < block.first || id > block.last) return false;
+        return offsetAt(block, lowerBound(block, id)) == uint32_t(id) - uint32_t(block.first);
+    }
+
+    // Adds an ID; false if it was already there.
+    bool insert(int32_t id) {
+        if (blocks.empty()) {
+            Block& block = blocks.emplace_back();
+            encode(&id, 1, block);
+            block.start = 0;
+            ++total;
+            return true;
+        }
+        size_t b = blockFor(id);
+        Block& block = blocks[b];
+        if (block.count == 2 * BLOCK) {
+            // Full: split it in two, then insert into the half that covers id
+            if (contains(id)) return false;
+            int32_t buffer[2 * BLOCK];
+            decode(block, buffer);
+            Block upper;
+            encode(buffer + BLOCK, BLOCK, upper);
+            encode(buffer, BLOCK, block);
+            upper.start = block.start + BLOCK;
+            blocks.insert(blocks.begin() + b + 1, move(upper));
+            return insert(id);
+        }
+        if (id > block.first && widthFor(uint32_t(id) - uint32_t(block.first)) <= block.width) {
+            // The offset fits the block's width: open a slot for it in place
+            uint32_t slot = lowerBound(block, id);
+            const uint32_t offset = uint32_t(id) - uint32_t(block.first);
+            if (slot < block.count && offsetAt(block, slot) == offset) return false;
+            block.offsets.insert(block.offsets.begin() + size_t(slot) * block.width, block.width, 0);
+            writeOffset(block.offsets.data() + size_t(slot) * block.width, block.width, offset);
+            block.last = max(block.last, id);
+            ++block.count;
+        } else {
+            // A new first ID or a wider offset: re-encode the block
+            if (id == block.first) return false;
+            int32_t buffer[2 * BLOCK];
+            uint32_t count = decode(block, buffer);
+            int32_t* slot = lower_bound(buffer, buffer + count, id);
+            move_backward(slot, buffer + count, buffer + count + 1);
+            *slot = id;
+            encode(buffer, count + 1, block);
+        }
+        ++total;
+        shiftStarts(b, 1);
+        return true;
+    }
+
+    // Removes an ID; false if it was not there.
+    bool erase(int32_t id) {
+        if (blocks.empty()) return false;
+        size_t b = blockFor(id);
+        Block& block = blocks[b];
+        if (id < block.first || id > block.last) return false;
+        uint32_t slot = lowerBound(block, id);
+        if (offsetAt(block, slot) != uint32_t(id) - uint32_t(block.first)) return false;
+        --total;
+        shiftStarts(b, -1);
+        if (block.count == 1) {
+            blocks.erase(blocks.begin() + b);
+        } else if (slot == 0) {
+            // The first ID goes: re-encode against the next one
+            int32_t buffer[2 * BLOCK];
+            uint32_t count = decode(block, buffer);
+            encode(buffer + 1, count - 1, block);
+        } else {
+            block.offsets.erase(block.offsets.begin() + size_t(slot) * block.width,
+                                block.offsets.begin() + size_t(slot + 1) * block.width);
+            --block.count;
+            block.last = static_cast<int32_t>(uint32_t(block.first) + offsetAt(block, block.count - 1));
+        }
+        return true;
+    }
+
+    // The k-th smallest ID (k < size()), in O(log n).
+    int32_t at(size_t k) const {
+        auto after = upper_bound(blocks.begin(), blocks.end(), k,
+                                 [](size_t rank, const Block& block) { return rank < block.start; });
+        const Block& block = *(after - 1);
+        return static_cast<int32_t>(uint32_t(block.first) + offsetAt(block, static_cast<uint32_t>(k - block.start)));
+    }
+
+    // Calls visit(id) for every ID in ascending order.
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        int32_t buffer[2 * BLOCK];
+        for (const Block& block : blocks) {
+            uint32_t count = decode(block, buffer);
+            for (uint32_t i = 0; i < count; ++i) visit(buffer[i]);
+        }
+    }
+
+    void appendTo(vector<int>& out) const {
+        size_t start = out.size();
+        out.resize(start + total);
+        int32_t* next = out.data() + start;
+        for (const Block& block : blocks) next += decode(block, next);
+    }
+};
+
+// Builds the compressed pool of a flat file from IDs in index order.
+inline void encodeIdPool(const vector<int32_t>& ids, vector<FlatIdBlock>& blocks, vector<uint8_t>& bytes) {
+    blocks.clear();
+    bytes.clear();
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i % ID_POOL_BLOCK == 0) {
+            blocks.push_back({ids[i], static_cast<uint32_t>(bytes.size())});
+        } else {
+            appendVarint(bytes, zigzag(static_cast<int32_t>(uint32_t(ids[i]) - uint32_t(ids[i - 1]))));
+        }
+    }
+}
+
+// Read-only view of the ID pool of a mapped flat file. Indices are checked
+// against count; a corrupt pool decodes to garbage IDs but never reads
+// outside the mapping.
+class IdPoolView {
+private:
+    enum class Layout { Empty, Compressed, Plain, Strings };
+    Layout layout;
+    uint32_t count;
+    const FlatIdBlock* blocks;
+    const uint8_t* bytes;        // compressed varints
+    uint32_t byteCount;
+    const int32_t* plain;        // older AVL files
+    const uint32_t* offsets;     // older trie files: string IDs
+    const char* chars;
+
+    static int32_t parse(string_view text) {
+        int32_t value = 0;
+        from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
+
+    // Decodes pool IDs [begin, end) of block b (all inside it) in order.
+    template <typename Visit>
+    bool decodeBlock(uint32_t b, uint32_t begin, uint32_t end, Visit& visit) const {
+        const uint8_t* p = bytes + min(blocks[b].byteOffset, byteCount);
+        const uint8_t* limit = bytes + byteCount;
+        uint32_t id = uint32_t(blocks[b].first);
+        // `id` is always the ID at `position`; those before `begin` are only stepped over
+        uint32_t position = b * ID_POOL_BLOCK;
+        for (; position < begin; ++position) id += uint32_t(unzigzag(readVarint(p, limit)));
+        while (visit(static_cast<int32_t>(id))) {
+            if (++position == end) return true;
+            id += uint32_t(unzigzag(readVarint(p, limit)));
+        }
+        return false;
+    }
+
+public:
+    IdPoolView()
+        : layout(Layout::Empty), count(0), blocks(nullptr), bytes(nullptr), byteCount(0), plain(nullptr),
+          offsets(nullptr), chars(nullptr) {}
+
+    // Size in bytes of a compressed pool's skip table.
+    static uint64_t blockTableSize(uint32_t idCount) {
+        return (uint64_t(idCount) + ID_POOL_BLOCK - 1) / ID_POOL_BLOCK * sizeof(FlatIdBlock);
+    }
+
+    void openCompressed(const char* start, uint32_t idCount, uint32_t idBytes) {
+        *this = IdPoolView();
+        layout = Layout::Compressed;
+        count = idCount;
+        blocks = reinterpret_cast<const FlatIdBlock*>(start);
+        bytes = reinterpret_cast<const uint8_t*>(start + blockTableSize(idCount));
+        byteCount = idBytes;
+    }
+
+    void openPlain(const int32_t* ids, uint32_t idCount) {
+        *this = IdPoolView();
+        layout = Layout::Plain;
+        count = idCount;
+        plain = ids;
+    }
+
+    // idOffsets[idCount + 1] followed by charCount characters.
+    void openStrings(const uint32_t* idOffsets, const char* idChars, uint32_t idCount, uint32_t charCount) {
+        *this = IdPoolView();
+        layout = Layout::Strings;
+        count = idCount;
+        offsets = idOffsets;
+        chars = idChars;
+        byteCount = charCount;
+    }
+
+    uint32_t size() const { return count; }
+
+    // True when each index's runs are sorted (current files).
+    bool sortedRuns() const { return layout == Layout::Compressed; }
+
+    // Calls visit(id) for pool IDs [begin, end) in order until it returns false.
+    template <typename Visit>
+    void forEach(uint32_t begin, uint32_t end, Visit visit) const {
+        end = min(end, count);
+        if (begin >= end) return;
+        switch (layout) {
+        case Layout::Compressed:
+            for (uint32_t b = begin / ID_POOL_BLOCK; b * ID_POOL_BLOCK < end; ++b) {
+                if (!decodeBlock(b, begin, min(end, (b + 1) * ID_POOL_BLOCK), visit)) return;
+            }
+            break;
+        case Layout::Plain:
+            for (uint32_t i = begin; i < end; ++i) {
+                if (!visit(plain[i])) return;
+            }
+            break;
+        case Layout::Strings:
+            for (uint32_t i = begin; i < end; ++i) {
+                uint32_t from = min(offsets[i], byteCount), to = min(max(offsets[i + 1], from), byteCount);
+                if (!visit(parse(string_view(chars + from, to - from)))) return;
+            }
+            break;
+        case Layout::Empty:
+            break;
+        }
+    }
+
+    int32_t at(uint32_t i) const {
+        int32_t found = 0;
+        forEach(i, i + 1, [&](int32_t id) { found = id; return false; });
+        return found;
+    }
+
+    void appendTo(uint32_t begin, uint32_t end, vector<int>& out) const {
+        end = min(end, count);
+        if (begin >= end) return;
+        size_t start = out.size();
+        out.resize(start + (end - begin));
+        int* next = out.data() + start;
+        forEach(begin, end, [&](int32_t id) { *next++ = id; return true; });
+    }
+
+    // Whether `id` is among pool IDs [begin, end). A sorted run of a
+    // compressed pool is searched through the skip table in O(log n) plus
+    // one block; anything else is scanned.
+    bool contains(uint32_t begin, uint32_t end, int32_t id) const {
+        end = min(end, count);
+        if (begin >= end) return false;
+        uint32_t from = begin;
+        if (layout == Layout::Compressed) {
+            // Blocks that start inside the run, by their (sorted) first IDs
+            uint32_t lo = (begin + ID_POOL_BLOCK - 1) / ID_POOL_BLOCK, hi = (end - 1) / ID_POOL_BLOCK + 1;
+            const FlatIdBlock* after = upper_bound(blocks + lo, blocks + max(lo, hi), id,
+                                                   [](int32_t value, const FlatIdBlock& block) { return value < block.first; });
+            if (after > blocks + lo) from = static_cast<uint32_t>(after - 1 - blocks) * ID_POOL_BLOCK;
+            end = min(end, (from / ID_POOL_BLOCK + 1) * ID_POOL_BLOCK);
+        }
+        bool found = false;
+        forEach(from, end, [&](int32_t value) {
+            if (value == id) found = true;
+            return !found && (!sortedRuns() || value < id);
+        });
+        return found;
+    }
+};
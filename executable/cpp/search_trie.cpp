@@ -1,4 +1,4 @@
-#include "trie.h" // Includes TrieNode and Trie definitions
+#include "token_index.h" // Includes TrieNode and Trie definitions
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -10,8 +10,53 @@
 using namespace std;
 
 int main(int argc, char* argv[]) {
-if (argc != 2) {
-cerr << "Usage: " << argv[0] << " <name_to_search>" << endl;
+MetricsReport metrics("search_trie", argc, argv);
+// Optional paging: --limit K returns at most K IDs and, if more remain, a
+// final "next_cursor <cursor>" line; pass it back with --cursor for the next page.
+// --fuzzy D (or auto) tolerates up to D typos and prints "<id> <distance>"
+// lines, closest first (see fuzzy.h); it can be combined with --limit only.
+// --match tokens matches every query word against any part of the name
+// (see token_index.h) and prints IDs in ascending order; --limit applies.
+size_t limit = 0;
+string cursor;
+string fuzzy;
+string match = "name";
+int maxDistance = -1;
+bool usageError = argc < 2 || argc % 2 != 0;
+for (int i = 2; i + 1 < argc && !usageError; i += 2) {
+const string option = argv[i];
+if (option == "--limit") {
+try {
+long long value = stoll(argv[i + 1]);
+usageError = value <= 0;
+limit = static_cast<size_t>(value);
+} catch (const exception&) {
+usageError = true;
+}
+} else if (option == "--fuzzy") {
+fuzzy = argv[i + 1];
+if (fuzzy != "auto") {
+try {
+size_t used;
+maxDistance = stoi(fuzzy, &used);
+usageError = used != fuzzy.size() || maxDistance < 0 || maxDistance > MAX_FUZZY_DISTANCE;
+} catch (const exception&) {
+usageError = true;
+}
+}
+} else if (option == "--match") {
+match = argv[i + 1];
+usageError = match != "name" && match != "tokens";
+} else if (option == "--cursor") {
+SearchCursor position;
+cursor = argv[i + 1];
+usageError = !SearchCursor::decode(cursor, position);
+} else {
+usageError = true;
+}
+}
+if (usageError || (!fuzzy.empty() && !cursor.empty()) || (match == "tokens" && (!fuzzy.empty() || !cursor.empty()))) {
+cerr << "Usage: " << argv[0] << " <name_to_search> [--limit K] [--cursor C | --fuzzy <max_distance|auto> | --match name|tokens]" << endl;
 return 1;
 }
 
@@ -19,21 +64,56 @@ const string nameToSearch = argv[1];
 // Correcting the file path: ../serialized/name.dat from the cpp directory
 const string trieFilename = "../serialized/name.dat";
 
-Trie trie;
-// Check if the file exists and deserialize
+// Check if the file exists
 ifstream fileCheck(trieFilename);
 if (!fileCheck.is_open()) {
 cerr << "Error: Trie data file not found at " << trieFilename << endl;
 return 1;
 }
 fileCheck.close();
-// Deserialize the trie
+if (match == "tokens") {
+const string tokensFilename = tokenIndexFile(trieFilename);
+vector<int> ids;
+TrieView tokenView;
+if (TrieView::isFlat(tokensFilename) && tokenView.open(tokensFilename)) {
+ids = searchTokens(tokenView, nameToSearch, limit);
+} else {
+// No token index on disk yet: derive it from the names
+Trie trie;
+if (!trie.deserialize(trieFilename)) {
+cerr << "Failed to deserialize the trie from " << trieFilename << endl;
+return 1;
+}
+ids = searchTokens(buildTokenIndex(trie), nameToSearch, limit);
+}
+if (ids.empty()) cout << "-1" << endl;
+for (int id : ids) cout << id << endl;
+return 0;
+}
+// Search for the name: current flat files are queried in place through mmap,
+// legacy and older flat files are deserialized first
+vector<int> studentIds;
+vector<FuzzyMatch> matches;
+string nextCursor;
+if (!fuzzy.empty() && maxDistance < 0) maxDistance = defaultFuzzyDistance(foldName(nameToSearch).size());
+TrieView view;
+if (TrieView::isFlat(trieFilename) && view.open(trieFilename)) {
+if (fuzzy.empty()) studentIds = view.search(nameToSearch, limit, cursor, &nextCursor);
+else matches = view.fuzzySearch(nameToSearch, maxDistance, limit);
+} else {
+Trie trie;
 if (!trie.deserialize(trieFilename)) {
 cerr << "Failed to deserialize the trie from " << trieFilename << endl;
 return 1;
 }
-// Search for the name
-vector<string> studentIds = trie.search(nameToSearch);
+if (fuzzy.empty()) studentIds = trie.search(nameToSearch, limit, cursor, &nextCursor);
+else matches = trie.fuzzySearch(nameToSearch, maxDistance, limit);
+}
+if (!fuzzy.empty()) {
+if (matches.empty()) cout << "-1" << endl;
+for (const auto& match : matches) cout << match.studentId << " " << match.distance << endl;
+return 0;
+}
 // Output student IDs
 if (studentIds.empty()) {
 cout << "-1" << endl;
@@ -41,6 +121,9 @@ cout << "-1" << endl;
 for (const auto& id : studentIds) {
 cout << id << endl;
 }
+if (!nextCursor.empty()) {
+cout << "next_cursor " << nextCursor << endl;
+}
 }
 
 return 0;
@@ -1,26 +1,65 @@
-#include "avl.h"
+#include "bucket_index.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
 using namespace std;
 
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--index=avl|bucket] [--count] <dat_file_name> <threshold> <direction>" << endl;
+    cerr << "       " << program << " [--index=avl|bucket] [--count] <dat_file_name> --range <lo> <hi>" << endl;
+    cerr << "  direction: 1 for above threshold, -1 for below threshold" << endl;
+    cerr << "  --range: students with lo <= attendance <= hi" << endl;
+    cerr << "  --index: avl (default) queries the flat file in place; bucket loads a" << endl;
+    cerr << "           counting index (see bucket_index.h)" << endl;
+    cerr << "  --count: print the number of matching students instead of their IDs" << endl;
+}
+
+// Removes every occurrence of flag from argv, like takeIndexFlag, so it may
+// appear anywhere on the command line. True if it was there.
+static bool takeFlag(int& argc, char* argv[], const string& flag) {
+    int kept = 1;
+    bool found = false;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i] == flag) found = true;
+        else argv[kept++] = argv[i];
+    }
+    argc = kept;
+    return found;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        cerr << "Usage: " << argv[0] << " <dat_file_name> <threshold> <direction>" << endl;
-        cerr << "  direction: 1 for above threshold, -1 for below threshold" << endl;
+    MetricsReport metrics("threshold", argc, argv);
+    bool useBuckets;
+    if (!takeIndexFlag(argc, argv, useBuckets)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const bool countOnly = takeFlag(argc, argv, "--count");
+    if (argc != 4 && !(argc == 5 && string(argv[2]) == "--range")) {
+        printUsage(argv[0]);
         return 1;
     }
 
     const string datFilename = argv[1];
-    int threshold, direction;
+    const bool rangeQuery = (argc == 5);
+    int threshold = 0, direction = 0, lo = 0, hi = 0;
 
     try {
-        threshold = stoi(argv[2]);
-        direction = stoi(argv[3]);
-        if (direction != 1 && direction != -1) {
-            cerr << "Direction must be 1 (above) or -1 (below)" << endl;
-            return 1;
+        if (rangeQuery) {
+            lo = stoi(argv[3]);
+            hi = stoi(argv[4]);
+            if (lo > hi) {
+                cerr << "Range lower bound must not exceed upper bound" << endl;
+                return 1;
+            }
+        } else {
+            threshold = stoi(argv[2]);
+            direction = stoi(argv[3]);
+            if (direction != 1 && direction != -1) {
+                cerr << "Direction must be 1 (above) or -1 (below)" << endl;
+                return 1;
+            }
         }
     } catch (const exception& e) {
         cerr << "Error parsing arguments: " << e.what() << endl;
@@ -34,14 +73,53 @@ int main(int argc, char* argv[]) {
     }
     fileCheck.close();
 
-    AVLTree avlTree;
-    if (!avlTree.deserialize(datFilename)) {
-        cerr << "Failed to deserialize the AVL tree from " << datFilename << endl;
-        return 1;
+    // Flat files are queried in place through mmap; legacy files are
+    // deserialized into a tree first.
+    vector<int> studentIds;
+    if (useBuckets) {
+        BucketIndex index;
+        if (!index.deserialize(datFilename)) {
+            cerr << "Failed to load a bucket index from " << datFilename << endl;
+            return 1;
+        }
+        if (countOnly) {
+            // Answered from the Fenwick tree without touching any bucket
+            cout << (rangeQuery ? index.countInRange(lo, hi) : index.countByThreshold(threshold, direction)) << endl;
+            return 0;
+        }
+        studentIds = rangeQuery
+            ? index.getStudentIdsInRange(lo, hi)
+            : index.getStudentIdsByThreshold(threshold, direction);
+    } else if (AVLView::isFlat(datFilename)) {
+        AVLView view;
+        if (!view.open(datFilename)) {
+            cerr << "Failed to map the AVL index from " << datFilename << endl;
+            return 1;
+        }
+        if (countOnly) {
+            // Summed from the keys' ID counts without decoding any ID
+            cout << (rangeQuery ? view.countInRange(lo, hi) : view.countByThreshold(threshold, direction)) << endl;
+            return 0;
+        }
+        studentIds = rangeQuery
+            ? view.getStudentIdsInRange(lo, hi)
+            : view.getStudentIdsByThreshold(threshold, direction);
+    } else {
+        AVLTree avlTree;
+        if (!avlTree.deserialize(datFilename)) {
+            cerr << "Failed to deserialize the AVL tree from " << datFilename << endl;
+            return 1;
+        }
+        if (countOnly) {
+            // From the subtree sizes in O(log n)
+            cout << (rangeQuery ? avlTree.countInRange(lo, hi) : avlTree.countByThreshold(threshold, direction)) << endl;
+            return 0;
+        }
+        studentIds = rangeQuery
+            ? avlTree.getStudentIdsInRange(lo, hi)
+            : avlTree.getStudentIdsByThreshold(threshold, direction);
     }
 
-    vector<int> studentIds = avlTree.getStudentIdsByThreshold(threshold, direction);
-
     if (studentIds.empty()) {
         cout << "-1" << endl;
     } else {
@@ -51,4 +129,4 @@ int main(int argc, char* argv[]) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
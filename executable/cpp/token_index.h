@@ -0,0 +1,126 @@
+#pragma once
+#include "trie.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+// Token index over student names, so a student can be found by surname or
+// any other part of the name. Every whitespace-separated token of a name is
+// folded (case and Latin diacritics, see fuzzy.h) and inserted into a second
+// radix trie, <serialized>/name_tokens.dat, under the student's ID. It uses
+// the same flat format as name.dat, so the tools query it in place with
+// TrieView.
+//
+// A query is split into tokens the same way, and each query token is a
+// prefix: "Aa Sh" finds every student with a name part starting with "aa"
+// and another starting with "sh", e.g. "Aarav Sharma" and "Shreya Aanand".
+// Each query token's IDs form a posting list, sorted numerically and free
+// of duplicates (the trie keeps IDs as numbers, see posting_list.h). The
+// lists are intersected smallest first, and each candidate is looked up in
+// the longer list by galloping (exponential then binary search), so the
+// cost follows the shortest list rather than the longest. Results come out
+// in ascending student ID order.
+
+// Folded tokens of a name, each once, in order of first appearance.
+inline vector<string> nameTokens(string_view name) {
+    vector<string> tokens;
+    size_t pos = 0;
+    while (pos < name.size()) {
+        while (pos < name.size() && isspace(static_cast<unsigned char>(name[pos]))) ++pos;
+        size_t end = pos;
+        while (end < name.size() && !isspace(static_cast<unsigned char>(name[end]))) ++end;
+        if (end > pos) {
+            string token = foldText(name.substr(pos, end - pos));
+            if (find(tokens.begin(), tokens.end(), token) == tokens.end()) tokens.push_back(move(token));
+        }
+        pos = end;
+    }
+    return tokens;
+}
+
+// Token index file kept next to a name trie: name.dat -> name_tokens.dat.
+inline string tokenIndexFile(const string& trieFilename) {
+    const string suffix = ".dat";
+    if (trieFilename.size() >= suffix.size() &&
+        trieFilename.compare(trieFilename.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return trieFilename.substr(0, trieFilename.size() - suffix.size()) + "_tokens.dat";
+    }
+    return trieFilename + "_tokens";
+}
+
+inline void insertNameTokens(Trie& tokens, string_view name, int studentId) {
+    for (const auto& token : nameTokens(name)) tokens.insert(token, studentId);
+}
+
+// Token index of every name in a name trie, for files written before the
+// token index existed.
+inline Trie buildTokenIndex(const Trie& names) {
+    Trie tokens;
+    names.forEachName([&](const string& name, const PostingList& studentIds) {
+        for (const auto& token : nameTokens(name)) {
+            studentIds.forEach([&](int studentId) { tokens.insert(token, studentId); });
+        }
+    });
+    return tokens;
+}
+
+// Sorted, duplicate-free IDs of a prefix search: a prefix spans many
+// names, each sorted on its own.
+inline vector<int> postingList(vector<int> list) {
+    sort(list.begin(), list.end());
+    list.erase(unique(list.begin(), list.end()), list.end());
+    return list;
+}
+
+// First position at or after `from` whose value is >= `value`: probes
+// from, from+1, from+2, from+4, ... until it passes `value`, then
+// binary-searches the last step. Costs O(log d) for a jump of d positions.
+inline size_t gallop(const vector<int>& list, size_t from, int value) {
+    size_t step = 1, low = from, high = from;
+    while (high < list.size() && list[high] < value) {
+        low = high + 1;
+        high = from + step;
+        step *= 2;
+    }
+    high = min(high, list.size());
+    return lower_bound(list.begin() + low, list.begin() + high, value) - list.begin();
+}
+
+// IDs present in every list, ascending.
+inline vector<int> intersectPostings(vector<vector<int>> lists) {
+    if (lists.empty()) return {};
+    sort(lists.begin(), lists.end(), [](const vector<int>& a, const vector<int>& b) { return a.size() < b.size(); });
+    vector<int> result = move(lists[0]);
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l) {
+        const vector<int>& other = lists[l];
+        size_t kept = 0, pos = 0;
+        for (int id : result) {
+            pos = gallop(other, pos, id);
+            if (pos == other.size()) break;
+            if (other[pos] == id) result[kept++] = id;
+        }
+        result.resize(kept);
+    }
+    return result;
+}
+
+// IDs of the students whose names have, for every token of `query`, a
+// token starting with it; ascending, at most `limit` (0 means no limit).
+// Works on a Trie or a TrieView of a token index.
+template <typename Index>
+vector<int> searchTokens(const Index& tokens, string_view query, size_t limit = 0) {
+    vector<string> queryTokens = nameTokens(query);
+    if (queryTokens.empty()) return {};
+    vector<vector<int>> lists;
+    for (const auto& token : queryTokens) {
+        lists.push_back(postingList(tokens.search(token)));
+        if (lists.back().empty()) return {};
+    }
+    vector<int> result = intersectPostings(move(lists));
+    if (limit != 0 && result.size() > limit) result.resize(limit);
+    return result;
+}
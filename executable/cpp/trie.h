@@ -1,164 +1,823 @@
 #pragma once
+#include "node_pool.h"
+#include "flat_format.h"
+#include "csv_reader.h"
+#include "fuzzy.h"
+#include "posting_list.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <string_view>
 #include <unordered_map>
-#include <memory>
 #include <algorithm>
 
 using namespace std;
 
-// Trie node structure
+// Radix (path-compressed) trie node: each node owns the whole edge label
+// leading to it, so chains of single-child nodes collapse into one. Children
+// are kept in a sorted array with their first label bytes alongside, so a
+// lookup binary-searches a few contiguous bytes instead of hashing. A name's
+// students are a compressed sorted list (posting_list.h), so IDs come out in
+// ascending order within a name.
 struct TrieNode {
     bool isEndOfName;
-    unordered_map<char, shared_ptr<TrieNode>> children;
-    vector<string> studentIds;
+    string label;              // edge label from the parent (empty at the root)
+    string childBytes;         // first label byte of each child, ascending
+    vector<int32_t> children;  // parallel to childBytes
+    PostingList studentIds;
 
     TrieNode() : isEndOfName(false) {}
+    explicit TrieNode(string edgeLabel) : isEndOfName(false), label(move(edgeLabel)) {}
+};
+
+// Orders label bytes as unsigned char, matching the flat format's sort order.
+inline bool labelByteLess(char a, char b) {
+    return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+}
+
+// (student ID, name) of every students.csv record (student_id, name, rn, ...)
+// after the header, sorted by ID. Inserting in this order only ever appends
+// to a name's PostingList, which builds a whole trie several times faster
+// than CSV order. Names point into `csv`. Returns the number of records
+// skipped for an invalid student ID.
+inline size_t readStudentNames(CSVReader& csv, vector<pair<int, string_view>>& records) {
+    size_t skipped = 0;
+    records.clear();
+    csv.next();  // header
+    while (csv.next()) {
+        int studentId;
+        if (csv.size() < 3) continue;
+        if (parseCSVInt(csv[0], studentId)) records.push_back({studentId, csv[1]});
+        else ++skipped;
+    }
+    stable_sort(records.begin(), records.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+    return skipped;
+}
+
+// Continuation point of a paginated prefix search: the page resumes at the
+// `skip`-th ID of `name`. Encoded as "<skip>:<hex name>" so the cursor is
+// opaque to callers, has no spaces and stays valid across inserts and
+// across the in-memory and mapped tries.
+struct SearchCursor {
+    string name;
+    size_t skip;
+
+    static string encode(const string& name, size_t skip) {
+        static const char HEX[] = "0123456789abcdef";
+        string cursor = to_string(skip) + ":";
+        for (unsigned char c : name) {
+            cursor += HEX[c >> 4];
+            cursor += HEX[c & 0xF];
+        }
+        return cursor;
+    }
+
+    static bool decode(const string& cursor, SearchCursor& out) {
+        size_t colon = cursor.find(':');
+        if (colon == string::npos || colon == 0 || (cursor.size() - colon - 1) % 2 != 0) return false;
+        out.skip = 0;
+        for (size_t i = 0; i < colon; ++i) {
+            if (cursor[i] < '0' || cursor[i] > '9' || out.skip > (SIZE_MAX - 9) / 10) return false;
+            out.skip = out.skip * 10 + (cursor[i] - '0');
+        }
+        auto nibble = [](char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            return -1;
+        };
+        out.name.clear();
+        for (size_t i = colon + 1; i < cursor.size(); i += 2) {
+            int high = nibble(cursor[i]), low = nibble(cursor[i + 1]);
+            if (high < 0 || low < 0) return false;
+            out.name += static_cast<char>(high << 4 | low);
+        }
+        return true;
+    }
 };
 
 class Trie {
 private:
-    shared_ptr<TrieNode> root;
+    NodePool<TrieNode> nodes;
+    int32_t root;
 
-    // Helper function to serialize the trie (Binary I/O)
-    void serializeHelper(ofstream& outFile, const shared_ptr<TrieNode>& node) {
-        outFile.write(reinterpret_cast<const char*>(&node->isEndOfName), sizeof(bool));
-        
-        size_t numIds = node->studentIds.size();
-        outFile.write(reinterpret_cast<const char*>(&numIds), sizeof(size_t));
-        
-        for (const auto& id : node->studentIds) {
-            size_t idLength = id.length();
-            outFile.write(reinterpret_cast<const char*>(&idLength), sizeof(size_t));
-            outFile.write(id.c_str(), idLength);
+    struct FlatTrieBuffers {
+        vector<FlatTrieNode> nodes;
+        vector<int32_t> order;  // pool index of each flat node
+        string firstBytes;
+        string labels;
+        vector<int32_t> ids;
+    };
+
+    // Position of the child starting with `c`, or where it would be inserted.
+    size_t childSlot(int32_t node, char c) const {
+        const string& bytes = nodes[node].childBytes;
+        return lower_bound(bytes.begin(), bytes.end(), c, labelByteLess) - bytes.begin();
+    }
+
+    int32_t findChild(int32_t node, char c) const {
+        size_t slot = childSlot(node, c);
+        const TrieNode& current = nodes[node];
+        return slot < current.childBytes.size() && current.childBytes[slot] == c ? current.children[slot] : NULL_NODE;
+    }
+
+    // Node whose path spells exactly `name`, created (splitting an edge if
+    // needed) when absent.
+    int32_t insertPath(const string& name) {
+        int32_t current = root;
+        size_t pos = 0;
+        while (pos < name.size()) {
+            Metrics::add(Counter::NodesVisited);
+            size_t slot = childSlot(current, name[pos]);
+            if (slot == nodes[current].children.size() || nodes[current].childBytes[slot] != name[pos]) {
+                // Allocate first: the pool may move and invalidate references.
+                int32_t leaf = nodes.allocate(name.substr(pos));
+                nodes[current].childBytes.insert(slot, 1, name[pos]);
+                nodes[current].children.insert(nodes[current].children.begin() + slot, leaf);
+                return leaf;
+            }
+
+            int32_t child = nodes[current].children[slot];
+            const string& label = nodes[child].label;
+            size_t common = 1;
+            while (common < label.size() && pos + common < name.size() && label[common] == name[pos + common]) {
+                ++common;
+            }
+            if (common < label.size()) {
+                // The name diverges inside this edge: split it at `common`.
+                int32_t middle = nodes.allocate(label.substr(0, common));
+                nodes[child].label.erase(0, common);
+                nodes[middle].childBytes.push_back(nodes[child].label[0]);
+                nodes[middle].children.push_back(child);
+                nodes[current].children[slot] = middle;
+                child = middle;
+            }
+            current = child;
+            pos += common;
         }
-        
-        size_t numChildren = node->children.size();
-        outFile.write(reinterpret_cast<const char*>(&numChildren), sizeof(size_t));
-        
-        for (const auto& [ch, childNode] : node->children) {
-            outFile.write(&ch, sizeof(char));
-            serializeHelper(outFile, childNode);
+        return current;
+    }
+
+    // Lays the trie out breadth-first so every node's children are contiguous.
+    void flattenNodes(FlatTrieBuffers& flat) const {
+        flat.order.push_back(root);
+        for (size_t i = 0; i < flat.order.size(); ++i) {
+            const TrieNode& current = nodes[flat.order[i]];
+            flat.nodes.push_back({static_cast<uint32_t>(flat.order.size()),
+                                  static_cast<uint32_t>(current.children.size()),
+                                  static_cast<uint32_t>(flat.labels.size()),
+                                  static_cast<uint32_t>(current.label.size()), 0, 0, 0});
+            flat.firstBytes.push_back(current.label.empty() ? '\0' : current.label[0]);
+            flat.labels += current.label;
+            flat.order.insert(flat.order.end(), current.children.begin(), current.children.end());
+        }
+    }
+
+    // Helper function to number IDs in depth-first order, children by label
+    void flattenIds(uint32_t index, FlatTrieBuffers& flat) const {
+        const TrieNode& current = nodes[flat.order[index]];
+        FlatTrieNode& flatNode = flat.nodes[index];
+        flatNode.idBegin = static_cast<uint32_t>(flat.ids.size());
+        if (current.isEndOfName) {
+            flatNode.ownIdCount = static_cast<uint32_t>(current.studentIds.size());
+            current.studentIds.appendTo(flat.ids);
+        }
+        uint32_t firstChild = flatNode.firstChild, childCount = flatNode.childCount;
+        for (uint32_t i = 0; i < childCount; ++i) {
+            flattenIds(firstChild + i, flat);
+        }
+        flat.nodes[index].subtreeIdEnd = static_cast<uint32_t>(flat.ids.size());
+    }
+
+    // Marks the node spelling `path` as a name and adds IDs stored as strings
+    // by older files; IDs that are not numbers are dropped.
+    void insertLegacyIds(const string& path, const vector<string_view>& studentIds) {
+        int32_t node = insertPath(path);
+        nodes[node].isEndOfName = true;
+        for (string_view id : studentIds) {
+            int studentId;
+            if (parseCSVInt(id, studentId)) nodes[node].studentIds.insert(studentId);
         }
     }
-    
-    // Helper function to deserialize the trie (Binary I/O)
-    shared_ptr<TrieNode> deserializeHelper(ifstream& inFile) {
-        if (inFile.eof() || inFile.peek() == EOF) return nullptr;
+
+    // Helper function to deserialize a legacy (pre-flat) trie file. The legacy
+    // layout has one node per character, so names are re-inserted by path.
+    bool deserializeHelper(ifstream& inFile, string& path) {
+        if (inFile.eof() || inFile.peek() == EOF) return false;
         bool isEndOfName;
         inFile.read(reinterpret_cast<char*>(&isEndOfName), sizeof(bool));
-        if (inFile.fail() && !inFile.eof()) return nullptr;
-
-        auto node = make_shared<TrieNode>();
-        node->isEndOfName = isEndOfName;
+        if (inFile.fail() && !inFile.eof()) return false;
 
+        vector<string> studentIds;
         size_t numIds;
         inFile.read(reinterpret_cast<char*>(&numIds), sizeof(size_t));
-        for (size_t i = 0; i < numIds; ++i) {
+        for (size_t i = 0; i < numIds && inFile; ++i) {
             size_t idLength;
             inFile.read(reinterpret_cast<char*>(&idLength), sizeof(size_t));
             string studentId(idLength, '\0');
             inFile.read(&studentId[0], idLength);
-            node->studentIds.push_back(studentId);
+            studentIds.push_back(studentId);
         }
+        if (isEndOfName) insertLegacyIds(path, vector<string_view>(studentIds.begin(), studentIds.end()));
 
         size_t numChildren;
         inFile.read(reinterpret_cast<char*>(&numChildren), sizeof(size_t));
-        for (size_t i = 0; i < numChildren; ++i) {
+        for (size_t i = 0; i < numChildren && inFile; ++i) {
             char ch;
             inFile.read(&ch, sizeof(char));
-            node->children[ch] = deserializeHelper(inFile);
+            path.push_back(ch);
+            deserializeHelper(inFile, path);
+            path.pop_back();
         }
-        return node;
+        return true;
     }
 
-    // Helper function to find the node corresponding to the prefix
-    shared_ptr<TrieNode> searchNode(const string& prefix) {
-        shared_ptr<TrieNode> current = root;
-        for (char c : prefix) {
-            if (current->children.find(c) == current->children.end()) {
-                return nullptr;
+    // Helper function to find the node covering every name that starts with
+    // `prefix`; the prefix may end part-way through that node's label.
+    // `path`, if given, receives the full name of that node.
+    int32_t searchNode(const string& prefix, string* path = nullptr) const {
+        int32_t current = root;
+        size_t pos = 0;
+        while (pos < prefix.size()) {
+            Metrics::add(Counter::NodesVisited);
+            int32_t child = findChild(current, prefix[pos]);
+            if (child == NULL_NODE) {
+                return NULL_NODE;
+            }
+            const string& label = nodes[child].label;
+            size_t length = min(label.size(), prefix.size() - pos);
+            if (label.compare(0, length, prefix, pos, length) != 0) {
+                return NULL_NODE;
             }
-            current = current->children[c];
+            if (path) *path += label;
+            pos += length;
+            current = child;
         }
         return current;
     }
 
-    // New helper function to recursively collect all IDs under a node
-    void collectIdsUnderNode(const shared_ptr<TrieNode>& node, vector<string>& result) {
-        if (!node) return;
+    // One level of a paginated depth-first walk.
+    struct SearchFrame {
+        int32_t node;
+        size_t nextChild;   // next child slot to descend into
+        size_t pathLength;  // length of this node's name
+    };
 
-        if (node->isEndOfName) {
-            result.insert(result.end(), node->studentIds.begin(), node->studentIds.end());
+    // Frames from the root down to the node spelling exactly `name`, with
+    // each ancestor positioned just past the child on the path. Empty if the
+    // name is not in the trie.
+    vector<SearchFrame> framesTo(const string& name) const {
+        vector<SearchFrame> frames = {{root, 0, 0}};
+        size_t pos = 0;
+        while (pos < name.size()) {
+            SearchFrame& parent = frames.back();
+            size_t slot = childSlot(parent.node, name[pos]);
+            const TrieNode& current = nodes[parent.node];
+            if (slot == current.children.size() || current.childBytes[slot] != name[pos]) return {};
+            int32_t child = current.children[slot];
+            const string& label = nodes[child].label;
+            if (name.compare(pos, label.size(), label) != 0) return {};
+            parent.nextChild = slot + 1;
+            pos += label.size();
+            frames.push_back({child, 0, pos});
         }
+        return frames;
+    }
+
+    // New helper function to recursively collect all IDs under a node
+    void collectIdsUnderNode(int32_t node, vector<int>& result) const {
+        if (node == NULL_NODE) return;
+        Metrics::add(Counter::NodesVisited);
+        const TrieNode& current = nodes[node];
 
-        for (const auto& [ch, childNode] : node->children) {
+        if (current.isEndOfName) current.studentIds.appendTo(result);
+
+        for (int32_t childNode : current.children) {
             collectIdsUnderNode(childNode, result);
         }
     }
 
-public:
-    Trie() {
-        root = make_shared<TrieNode>();
+    template <typename Visit>
+    void forEachNameUnder(int32_t node, string& path, Visit& visit) const {
+        const TrieNode& current = nodes[node];
+        size_t length = path.size();
+        path += current.label;
+        if (current.isEndOfName) visit(path, current.studentIds);
+        for (int32_t child : current.children) forEachNameUnder(child, path, visit);
+        path.resize(length);
     }
 
-    void insert(const string& name, const string& studentId) {
-        shared_ptr<TrieNode> current = root;
-        for (char c : name) {
-            if (current->children.find(c) == current->children.end()) {
-                current->children[c] = make_shared<TrieNode>();
+    // Adds every ID below `node` at `distance`, until the collector has no
+    // room left at that distance.
+    void addSubtree(int32_t node, int distance, FuzzyCollector& collector) const {
+        const TrieNode& current = nodes[node];
+        current.studentIds.forEach([&](int studentId) { collector.add(studentId, distance); });
+        for (int32_t child : current.children) {
+            if (distance > collector.currentBudget()) return;
+            addSubtree(child, distance, collector);
+        }
+    }
+
+    // Fuzzy walk below `node`, whose label has already been fed to `state`.
+    void fuzzyWalk(int32_t node, const FuzzyAutomaton::State& state, const FuzzyAutomaton& automaton,
+                   FuzzyCollector& collector) const {
+        Metrics::add(Counter::NodesVisited);
+        const TrieNode& current = nodes[node];
+        if (FuzzyAutomaton::floor(state) >= state.best) {
+            // Nothing below gets closer: the whole subtree is at state.best
+            addSubtree(node, state.best, collector);
+            return;
+        }
+        if (current.isEndOfName) {
+            current.studentIds.forEach([&](int studentId) { collector.add(studentId, state.best); });
+        }
+        for (int32_t child : current.children) {
+            if (collector.currentBudget() < 0) return;
+            FuzzyAutomaton::State next = state;
+            if (automaton.feed(next, nodes[child].label, collector.currentBudget())) {
+                fuzzyWalk(child, next, automaton, collector);
             }
-            current = current->children[c];
         }
-        current->isEndOfName = true;
-        current->studentIds.push_back(studentId);
     }
 
-    bool deserialize(const string& filename) {
+    // Reads a legacy recursive .dat file
+    bool deserializeLegacy(const string& filename) {
         ifstream inFile(filename, ios::binary);
         if (!inFile) return false;
-        root = deserializeHelper(inFile);
+        inFile.seekg(0, ios::end);
+        Metrics::add(Counter::BytesRead, static_cast<uint64_t>(max<streamoff>(inFile.tellg(), 0)));
+        inFile.seekg(0);
+        nodes.clear();
+        // An empty file yields no names; the trie stays usable for inserts and searches.
+        root = nodes.allocate();
+        string path;
+        deserializeHelper(inFile, path);
         inFile.close();
         return true;
     }
-    
-    // Main search function to perform prefix lookup
-    vector<string> search(const string& prefix) {
-        shared_ptr<TrieNode> startNode = searchNode(prefix);
-        vector<string> result;
+
+    // Reads a version 1 flat file (one node per character) by re-inserting names.
+    bool deserializeFlatV1(const MappedFile& file);
+
+public:
+    Trie() {
+        root = nodes.allocate();
+    }
+
+    // Adds a student under `name`; inserting the same pair again changes nothing.
+    void insert(const string& name, int studentId) {
+        ScopedTimer timer(Phase::TrieInsert);
+        int32_t node = insertPath(name);
+        nodes[node].isEndOfName = true;
+        nodes[node].studentIds.insert(studentId);
+    }
+
+    // Reads the flat format (either version) or a legacy recursive .dat file.
+    bool deserialize(const string& filename);
+
+    // Main search function to perform prefix lookup; results come out in
+    // lexicographic name order, ascending by ID within a name.
+    vector<int> search(const string& prefix) const {
+        ScopedTimer timer(Phase::TrieSearch);
+        int32_t startNode = searchNode(prefix);
+        vector<int> result;
         
-        if (startNode) {
+        if (startNode != NULL_NODE) {
             collectIdsUnderNode(startNode, result);
         }
         return result;
     }
 
-    bool serialize(const string& filename) {
-        ofstream outFile(filename, ios::binary);
-        if (!outFile) return false;
-        serializeHelper(outFile, root);
-        outFile.close();
-        return true;
+    // Paginated prefix lookup: at most `limit` IDs (0 means no limit) in the
+    // same order as search(), starting at `cursor` (empty for the first page).
+    // The walk stops as soon as the page is full; a later page descends
+    // straight to its cursor instead of re-walking earlier results.
+    // `nextCursor` receives the cursor of the following page, or is cleared
+    // after the last one. A cursor from another prefix yields an empty page.
+    vector<int> search(const string& prefix, size_t limit, const string& cursor, string* nextCursor) const {
+        ScopedTimer timer(Phase::TrieSearch);
+        vector<int> result;
+        if (nextCursor) nextCursor->clear();
+        string path;
+        int32_t startNode = searchNode(prefix, &path);
+        if (startNode == NULL_NODE) return result;
+
+        vector<SearchFrame> stack;
+        size_t skip = 0;
+        if (cursor.empty()) {
+            stack.push_back({startNode, 0, path.size()});
+        } else {
+            SearchCursor position;
+            if (!SearchCursor::decode(cursor, position)) return result;
+            vector<SearchFrame> frames = framesTo(position.name);
+            auto start = find_if(frames.begin(), frames.end(),
+                                 [&](const SearchFrame& frame) { return frame.node == startNode; });
+            if (start == frames.end()) return result;
+            stack.assign(start, frames.end());
+            path = position.name;
+            skip = position.skip;
+        }
+
+        // Emits a node's own IDs from `from`; false once the page is full.
+        vector<int> own;
+        auto emitOwn = [&](int32_t node, size_t from) {
+            const TrieNode& current = nodes[node];
+            if (!current.isEndOfName) return true;
+            own.clear();
+            current.studentIds.appendTo(own);
+            for (size_t i = from; i < own.size(); ++i) {
+                if (limit != 0 && result.size() == limit) {
+                    if (nextCursor) *nextCursor = SearchCursor::encode(path, i);
+                    return false;
+                }
+                result.push_back(own[i]);
+            }
+            return true;
+        };
+
+        if (!emitOwn(stack.back().node, skip)) return result;
+        while (!stack.empty()) {
+            SearchFrame& frame = stack.back();
+            const TrieNode& current = nodes[frame.node];
+            if (frame.nextChild == current.children.size()) {
+                stack.pop_back();
+                continue;
+            }
+            int32_t child = current.children[frame.nextChild++];
+            path.resize(frame.pathLength);
+            path += nodes[child].label;
+            stack.push_back({child, 0, path.size()});
+            Metrics::add(Counter::NodesVisited);
+            if (!emitOwn(child, 0)) break;
+        }
+        return result;
+    }
+
+    // Calls visit(name, studentIds) for every name, in lexicographic order;
+    // studentIds is the name's PostingList.
+    template <typename Visit>
+    void forEachName(Visit visit) const {
+        string path;
+        forEachNameUnder(root, path, visit);
+    }
+
+    // Typo-tolerant lookup (see fuzzy.h): IDs of names with a prefix within
+    // `maxDistance` edits of the query after case and diacritic folding,
+    // closest first and in name order within a distance; at most `limit`
+    // (0 means no limit).
+    vector<FuzzyMatch> fuzzySearch(const string& query, int maxDistance, size_t limit) const {
+        ScopedTimer timer(Phase::TrieSearch);
+        FuzzyAutomaton automaton(query, maxDistance);
+        FuzzyCollector collector(maxDistance, limit);
+        fuzzyWalk(root, automaton.start(), automaton, collector);
+        return collector.results();
+    }
+
+    // Always writes the flat format (see flat_format.h), replacing the file atomically.
+    bool serialize(const string& filename) const {
+        ScopedTimer timer(Phase::Serialize);
+        FlatTrieBuffers flat;
+        flattenNodes(flat);
+        flattenIds(0, flat);
+
+        vector<FlatIdBlock> blocks;
+        vector<uint8_t> idBytes;
+        encodeIdPool(flat.ids, blocks, idBytes);
+        FlatTrieHeader header = {{'T', 'R', 'I', 'X'}, FLAT_TRIE_VERSION,
+                                 static_cast<uint32_t>(flat.nodes.size()),
+                                 static_cast<uint32_t>(flat.labels.size()),
+                                 static_cast<uint32_t>(flat.ids.size()), static_cast<uint32_t>(idBytes.size())};
+        vector<char> contents;
+        appendRecord(contents, header);
+        appendRecords(contents, flat.nodes);
+        appendPaddedBytes(contents, flat.firstBytes);
+        appendPaddedBytes(contents, flat.labels);
+        appendRecords(contents, blocks);
+        appendPaddedBytes(contents, string(idBytes.begin(), idBytes.end()));
+        return writeFileAtomically(filename, contents);
     }
 };
 
-vector<string> parseCSVLine(const string& line) {
-    vector<string> result;
-    string current;
-    bool inQuotes = false;
-    for (char c : line) {
-        if (c == '"') {
-            inQuotes = !inQuotes;
-        } else if (c == ',' && !inQuotes) {
-            result.push_back(current);
-            current.clear();
+// Zero-copy reader for flat trie files: prefix searches walk the mapped
+// node, first-byte and label arrays and slice the ID pool without building
+// any nodes. Indices are bounds-checked as they are touched rather than up
+// front. Version 2 files (string IDs) are read too.
+class TrieView {
+private:
+    MappedFile file;
+    FlatTrieHeader header;
+    const FlatTrieNode* nodes;
+    const char* firstBytes;
+    const char* labels;
+    IdPoolView ids;
+
+public:
+    TrieView() : header{}, nodes(nullptr), firstBytes(nullptr), labels(nullptr) {}
+
+    static bool isFlat(const string& filename) {
+        return hasFlatMagic(filename, "TRIX");
+    }
+
+    // Format version of a flat file, or 0 for missing and legacy files.
+    static uint32_t readVersion(const string& filename) {
+        ifstream inFile(filename, ios::binary);
+        FlatTrieHeader found;
+        if (!inFile.read(reinterpret_cast<char*>(&found), sizeof(found)) ||
+            memcmp(found.magic, "TRIX", 4) != 0) return 0;
+        return found.version;
+    }
+
+    // Fails for missing, legacy, version 1 or malformed files.
+    bool open(const string& filename) {
+        header = {};
+        ids = IdPoolView();
+        if (!file.open(filename)) return false;
+        const char* bytes = file.data();
+        size_t length = file.size();
+        if (!hasFlatMagic(bytes, length, "TRIX") || length < sizeof(FlatTrieHeader)) return false;
+
+        memcpy(&header, bytes, sizeof(header));
+        uint64_t poolOffset = sizeof(header) + uint64_t(header.nodeCount) * sizeof(FlatTrieNode) +
+                              paddedTo4(header.nodeCount) + paddedTo4(header.labelBytes);
+        uint64_t needed = poolOffset + (header.version == 2
+                                            ? (uint64_t(header.idCount) + 1) * sizeof(uint32_t) + header.charCount
+                                            : IdPoolView::blockTableSize(header.idCount) + header.charCount);
+        if (header.version < 2 || header.version > FLAT_TRIE_VERSION || header.nodeCount == 0 || needed > length) {
+            header = {};
+            return false;
+        }
+        nodes = reinterpret_cast<const FlatTrieNode*>(bytes + sizeof(header));
+        firstBytes = reinterpret_cast<const char*>(nodes + header.nodeCount);
+        labels = firstBytes + paddedTo4(header.nodeCount);
+        if (header.version == 2) {
+            const uint32_t* idOffsets = reinterpret_cast<const uint32_t*>(bytes + poolOffset);
+            ids.openStrings(idOffsets, reinterpret_cast<const char*>(idOffsets + header.idCount + 1),
+                            header.idCount, header.charCount);
         } else {
-            current += c;
+            ids.openCompressed(bytes + poolOffset, header.idCount, header.charCount);
+        }
+        return true;
+    }
+
+    uint32_t nodeCount() const { return header.nodeCount; }
+    const FlatTrieNode& node(uint32_t i) const { return nodes[i]; }
+
+    // Children of a node as [first, last) node indices, or an empty range if
+    // the node is corrupt. Children always come after their parent.
+    pair<uint32_t, uint32_t> childrenOf(uint32_t i) const {
+        const FlatTrieNode& current = nodes[i];
+        if (current.firstChild <= i || uint64_t(current.firstChild) + current.childCount > header.nodeCount) {
+            return {0, 0};
+        }
+        return {current.firstChild, current.firstChild + current.childCount};
+    }
+
+    string_view label(uint32_t i) const {
+        const FlatTrieNode& current = nodes[i];
+        if (uint64_t(current.labelOffset) + current.labelLength > header.labelBytes) return {};
+        return string_view(labels + current.labelOffset, current.labelLength);
+    }
+
+    // Appends the IDs [begin, end) of the pool, in depth-first name order.
+    void appendIds(uint32_t begin, uint32_t end, vector<int>& out) const {
+        ids.appendTo(begin, end, out);
+    }
+
+    // Node covering every name that starts with `prefix`, or NULL_NODE.
+    // `path`, if given, receives the full name of that node.
+    int32_t findNode(const string& prefix, string* path = nullptr) const {
+        if (header.nodeCount == 0) return NULL_NODE;
+        uint32_t current = 0;
+        size_t pos = 0;
+        while (pos < prefix.size()) {
+            Metrics::add(Counter::NodesVisited);
+            auto [first, last] = childrenOf(current);
+            const char* slot = lower_bound(firstBytes + first, firstBytes + last, prefix[pos], labelByteLess);
+            if (slot == firstBytes + last || *slot != prefix[pos]) return NULL_NODE;
+            current = static_cast<uint32_t>(slot - firstBytes);
+
+            string_view edge = label(current);
+            size_t length = min(edge.size(), prefix.size() - pos);
+            if (length == 0 || edge.compare(0, length, string_view(prefix).substr(pos, length)) != 0) return NULL_NODE;
+            if (path) path->append(edge);
+            pos += length;
+        }
+        return static_cast<int32_t>(current);
+    }
+
+    // Node spelling exactly `name`, or NULL_NODE.
+    int32_t findExact(const string& name) const {
+        string path;
+        int32_t found = findNode(name, &path);
+        return found != NULL_NODE && path == name ? found : NULL_NODE;
+    }
+
+    // Node owning ID `index` below `start`, found by descending through
+    // children ordered by idBegin; `path` (the name of `start`) is extended
+    // to the owner's name.
+    uint32_t ownerOfId(uint32_t start, uint32_t index, string& path) const {
+        uint32_t current = start;
+        while (index >= nodes[current].idBegin + nodes[current].ownIdCount) {
+            auto [first, last] = childrenOf(current);
+            uint32_t child = last;
+            for (uint32_t lo = first, hi = last; lo < hi;) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (nodes[mid].idBegin <= index) {
+                    child = mid;
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (child == last) break;
+            current = child;
+            path += label(current);
+        }
+        return current;
+    }
+
+    // Same contract as Trie::search; results come out in lexicographic name order.
+    vector<int> search(const string& prefix) const {
+        ScopedTimer timer(Phase::TrieSearch);
+        vector<int> result;
+        int32_t start = findNode(prefix);
+        if (start == NULL_NODE) return result;
+        const FlatTrieNode& current = nodes[start];
+        appendIds(current.idBegin, current.subtreeIdEnd, result);
+        return result;
+    }
+
+    // Same contract and cursors as the paginated Trie::search. The prefix's
+    // IDs are one contiguous slice, so a page is a bounded copy and resuming
+    // only has to locate the cursor's name.
+    vector<int> search(const string& prefix, size_t limit, const string& cursor, string* nextCursor) const {
+        ScopedTimer timer(Phase::TrieSearch);
+        vector<int> result;
+        if (nextCursor) nextCursor->clear();
+        int32_t start = findNode(prefix);
+        if (start == NULL_NODE) return result;
+        const FlatTrieNode& current = nodes[start];
+        uint32_t begin = current.idBegin, end = min(current.subtreeIdEnd, header.idCount);
+
+        if (!cursor.empty()) {
+            SearchCursor position;
+            int32_t resume;
+            if (!SearchCursor::decode(cursor, position) || (resume = findExact(position.name)) == NULL_NODE ||
+                position.skip > nodes[resume].ownIdCount) return result;
+            uint64_t offset = uint64_t(nodes[resume].idBegin) + position.skip;
+            if (offset < begin || offset > end) return result;
+            begin = static_cast<uint32_t>(offset);
+        }
+
+        uint32_t stop = limit == 0 ? end : static_cast<uint32_t>(min<uint64_t>(end, uint64_t(begin) + limit));
+        appendIds(begin, stop, result);
+        if (stop < end && nextCursor) {
+            string name;
+            findNode(prefix, &name);
+            uint32_t owner = ownerOfId(static_cast<uint32_t>(start), stop, name);
+            *nextCursor = SearchCursor::encode(name, stop - nodes[owner].idBegin);
+        }
+        return result;
+    }
+
+    // Same contract as Trie::fuzzySearch. A subtree whose names all share a
+    // distance is one contiguous slice of the ID pool.
+    vector<FuzzyMatch> fuzzySearch(const string& query, int maxDistance, size_t limit) const {
+        ScopedTimer timer(Phase::TrieSearch);
+        FuzzyAutomaton automaton(query, maxDistance);
+        FuzzyCollector collector(maxDistance, limit);
+        if (header.nodeCount == 0) return collector.results();
+
+        struct Frame {
+            uint32_t node;
+            FuzzyAutomaton::State state;
+        };
+        vector<Frame> stack = {{0, automaton.start()}};
+        while (!stack.empty() && collector.currentBudget() >= 0) {
+            Frame frame = move(stack.back());
+            stack.pop_back();
+            Metrics::add(Counter::NodesVisited);
+            const FlatTrieNode& current = nodes[frame.node];
+            const int best = frame.state.best;
+            if (FuzzyAutomaton::floor(frame.state) >= best) {
+                ids.forEach(current.idBegin, current.subtreeIdEnd, [&](int32_t studentId) {
+                    collector.add(studentId, best);
+                    return best <= collector.currentBudget();
+                });
+                continue;
+            }
+            ids.forEach(current.idBegin, current.idBegin + current.ownIdCount, [&](int32_t studentId) {
+                collector.add(studentId, best);
+                return true;
+            });
+            // Children go on the stack last first, so they are visited in name order
+            auto [first, last] = childrenOf(frame.node);
+            for (uint32_t child = last; child > first; --child) {
+                FuzzyAutomaton::State next = frame.state;
+                if (automaton.feed(next, label(child - 1), collector.currentBudget())) {
+                    stack.push_back({child - 1, move(next)});
+                }
+            }
+        }
+        return collector.results();
+    }
+};
+
+bool Trie::deserializeFlatV1(const MappedFile& file) {
+    const char* bytes = file.data();
+    FlatTrieHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    uint32_t edgeCount = header.labelBytes;
+    uint64_t needed = sizeof(header) + uint64_t(header.nodeCount) * sizeof(FlatTrieNodeV1) +
+                      uint64_t(edgeCount) * sizeof(FlatTrieEdgeV1) +
+                      (uint64_t(header.idCount) + 1) * sizeof(uint32_t) + header.charCount;
+    if (header.nodeCount == 0 || needed > file.size()) return false;
+    const FlatTrieNodeV1* flatNodes = reinterpret_cast<const FlatTrieNodeV1*>(bytes + sizeof(header));
+    const FlatTrieEdgeV1* edges = reinterpret_cast<const FlatTrieEdgeV1*>(flatNodes + header.nodeCount);
+    const uint32_t* idOffsets = reinterpret_cast<const uint32_t*>(edges + edgeCount);
+    const char* idChars = reinterpret_cast<const char*>(idOffsets + header.idCount + 1);
+
+    nodes.clear();
+    root = nodes.allocate();
+
+    // Depth-first over the preorder arrays with an explicit stack. Each entry
+    // carries its depth and edge label, so the name is rebuilt in place: the
+    // last node popped at every shallower depth is always an ancestor.
+    struct Pending {
+        uint32_t flatIndex;
+        size_t depth;
+        char label;
+    };
+    string path;
+    vector<Pending> pending = {{0, 0, '\0'}};
+    while (!pending.empty()) {
+        Pending entry = pending.back();
+        pending.pop_back();
+        path.resize(entry.depth);
+        if (entry.depth > 0) path[entry.depth - 1] = entry.label;
+
+        const FlatTrieNodeV1& flatNode = flatNodes[entry.flatIndex];
+        if (flatNode.ownIdCount > 0) {
+            vector<string_view> studentIds;
+            for (uint32_t i = flatNode.idBegin; i < flatNode.idBegin + flatNode.ownIdCount; ++i) {
+                if (i >= header.idCount || idOffsets[i] > idOffsets[i + 1] || idOffsets[i + 1] > header.charCount) {
+                    return false;
+                }
+                studentIds.emplace_back(idChars + idOffsets[i], idOffsets[i + 1] - idOffsets[i]);
+            }
+            insertLegacyIds(path, studentIds);
+        }
+        if (uint64_t(flatNode.firstEdge) + flatNode.edgeCount > edgeCount) return false;
+        // Push in reverse so children are visited in label order.
+        for (uint32_t i = flatNode.edgeCount; i-- > 0;) {
+            const FlatTrieEdgeV1& edge = edges[flatNode.firstEdge + i];
+            if (edge.child >= header.nodeCount || edge.child <= entry.flatIndex) return false;
+            pending.push_back({edge.child, entry.depth + 1, edge.label});
+        }
+    }
+    return true;
+}
+
+bool Trie::deserialize(const string& filename) {
+    ScopedTimer timer(Phase::Deserialize);
+    if (!TrieView::isFlat(filename)) return deserializeLegacy(filename);
+    if (TrieView::readVersion(filename) == 1) {
+        MappedFile file;
+        return file.open(filename) && file.size() >= sizeof(FlatTrieHeader) && deserializeFlatV1(file);
+    }
+
+    TrieView view;
+    if (!view.open(filename)) return false;
+    nodes.clear();
+    root = nodes.allocate();
+
+    // Rebuild pooled nodes from the flat arrays (explicit stack, no recursion).
+    // Flat children are already sorted, so they are appended in order. IDs
+    // are sorted again for version 2 files, which kept insertion order.
+    vector<pair<uint32_t, int32_t>> pending = {{0, root}};
+    vector<int> ids;
+    while (!pending.empty()) {
+        auto [flatIndex, node] = pending.back();
+        pending.pop_back();
+        const FlatTrieNode& flatNode = view.node(flatIndex);
+        ids.clear();
+        view.appendIds(flatNode.idBegin, flatNode.idBegin + flatNode.ownIdCount, ids);
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        nodes[node].studentIds.assignSorted(ids.begin(), ids.end());
+        nodes[node].isEndOfName = flatNode.ownIdCount > 0;
+        if (flatNode.childCount > 0 && view.childrenOf(flatIndex).second == 0) return false;
+        auto [first, last] = view.childrenOf(flatIndex);
+        for (uint32_t child = first; child < last; ++child) {
+            string_view label = view.label(child);
+            if (label.empty()) return false;
+            int32_t pooled = nodes.allocate(string(label));
+            nodes[node].childBytes.push_back(label[0]);
+            nodes[node].children.push_back(pooled);
+            pending.push_back({child, pooled});
         }
     }
-    result.push_back(current);
-    return result;
-}
\ No newline at end of file
+    return true;
+}
@@ -1,28 +1,167 @@
 #include "avl.h" // Includes AVLNode and AVLTree definitions
+#include "bucket_index.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <memory>
 #include <algorithm>
 #include <map>
+#include <cerrno>
+#include <sys/stat.h>
 
 using namespace std;
 
+// Only a missing index (no snapshot and no update log) may start out empty.
+// Any other load failure (a truncated or corrupt snapshot, a format version
+// this build cannot read, a snapshot that kept changing during the load)
+// must not be overwritten by a tree holding just the new updates.
+static bool indexMissing(const string& datFilename) {
+    struct stat info;
+    if (stat(datFilename.c_str(), &info) == 0 || errno != ENOENT) return false;
+    return stat(UpdateLog::pathFor(datFilename).c_str(), &info) != 0 && errno == ENOENT;
+}
+
+// Batch mode: every input line is "<dat_file_name> <attendance> <student_id>".
+// Records are grouped per file, so each file is loaded once, receives all of
+// its updates in memory and is written back once. Index is AVLTree or
+// BucketIndex; both read and write the same snapshot format.
+template <typename Index>
+static int runBatch(istream& input) {
+    map<string, vector<pair<int, int>>> updatesByFile;  // file -> (studentId, attendance)
+    string line;
+    size_t lineNumber = 0;
+
+    while (getline(input, line)) {
+        ++lineNumber;
+        if (line.empty()) continue;
+        stringstream ss(line);
+        string datFilename;
+        int newAttendance, studentId;
+        if (!(ss >> datFilename >> newAttendance >> studentId) || !isValidAttendance(newAttendance)) {
+            cerr << "Skipping invalid input line " << lineNumber << ": " << line << endl;
+            continue;
+        }
+        updatesByFile[datFilename].push_back({studentId, newAttendance});
+    }
+
+    int failures = 0;
+    for (const auto& [datFilename, updates] : updatesByFile) {
+        WriterLock lock(datFilename);
+        if (!lock.held()) {
+            cerr << "Failed to lock " << datFilename << " for writing" << endl;
+            ++failures;
+            continue;
+        }
+        Index index;
+        if (!index.deserialize(datFilename)) {
+            if (!indexMissing(datFilename)) {
+                cerr << "Failed to load " << datFilename << "; leaving it unchanged" << endl;
+                ++failures;
+                continue;
+            }
+            cout << "File not found. Initializing new AVL tree for " << datFilename << "." << endl;
+        }
+
+        size_t updated = 0;
+        for (const auto& [studentId, newAttendance] : updates) {
+            if (index.updateAttendance(studentId, newAttendance)) ++updated;
+        }
+
+        if (!index.serialize(datFilename)) {
+            cerr << "Failed to serialize the updated AVL tree to " << datFilename << endl;
+            ++failures;
+            continue;
+        }
+        cout << datFilename << ": updated " << updated << ", inserted " << updates.size() - updated << endl;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+// Loads the whole index, applies one update and writes a fresh flat snapshot.
+// Used for missing or legacy files and to compact a long update log.
+template <typename Index>
+static int rewriteWithUpdate(const string& datFilename, int newAttendance, int studentId) {
+    Index index;
+
+    // Missing or legacy files: load fully and write a fresh flat snapshot
+    bool deserialize_success = index.deserialize(datFilename);
+
+    if (!deserialize_success) {
+        if (!indexMissing(datFilename)) {
+            cerr << "Failed to load " << datFilename << "; leaving it unchanged" << endl;
+            return 1;
+        }
+        // The file doesn't exist: start a new tree holding this student
+        cout << "File not found. Initializing new AVL tree for student ID " << studentId << "." << endl;
+    }
+
+    // Update the attendance for the student ID.
+    // This handles both inserting a new student and updating an existing one.
+    bool studentFoundBeforeUpdate = index.updateAttendance(studentId, newAttendance);
+
+    if (studentFoundBeforeUpdate) {
+        cout << "Updated attendance for student ID " << studentId << " to " << newAttendance << endl;
+    } else {
+        cout << "Inserted new entry for student ID " << studentId << " with attendance " << newAttendance << endl;
+    }
+
+    // Serialize the updated index back to the file
+    if (!index.serialize(datFilename)) {
+        cerr << "Failed to serialize the updated AVL tree to " << datFilename << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+template <typename Index>
+static bool compactLog(const string& datFilename) {
+    Index index;
+    return index.deserialize(datFilename) && index.serialize(datFilename);
+}
+
 int main(int argc, char* argv[]) {
+    MetricsReport metrics("update_avl", argc, argv);
+    // --index=bucket loads files into a BucketIndex instead of an AVLTree
+    bool useBuckets;
+    if (!takeIndexFlag(argc, argv, useBuckets)) {
+        cerr << "Unknown --index backend (expected avl or bucket)" << endl;
+        return 1;
+    }
+
+    if (argc >= 2 && string(argv[1]) == "--batch") {
+        if (argc > 3) {
+            cerr << "Usage: " << argv[0] << " [--index=avl|bucket] --batch [input_file]" << endl;
+            return 1;
+        }
+        if (argc == 3 && string(argv[2]) != "-") {
+            ifstream inputFile(argv[2]);
+            if (!inputFile) {
+                cerr << "Error opening batch file: " << argv[2] << endl;
+                return 1;
+            }
+            return useBuckets ? runBatch<BucketIndex>(inputFile) : runBatch<AVLTree>(inputFile);
+        }
+        return useBuckets ? runBatch<BucketIndex>(cin) : runBatch<AVLTree>(cin);
+    }
+
     if (argc != 4) {
-        cerr << "Usage: " << argv[0] << " <dat_file_name> <new_attendance> <student_id>" << endl;
+        cerr << "Usage: " << argv[0] << " [--index=avl|bucket] <dat_file_name> <new_attendance> <student_id>" << endl;
+        cerr << "       " << argv[0] << " [--index=avl|bucket] --batch [input_file]   (lines: <dat_file_name> <attendance> <student_id>)" << endl;
         return 1;
     }
 
     const string datFilename = argv[1];
     int newAttendance, studentId;
-    
+
     try {
         newAttendance = stoi(argv[2]);
         studentId = stoi(argv[3]);
-        
-        if (newAttendance < 0 || newAttendance > 100) {
+
+        if (!isValidAttendance(newAttendance)) {
             cerr << "Attendance should be between 0 and 100" << endl;
             return 1;
         }
@@ -30,33 +169,40 @@ int main(int argc, char* argv[]) {
         cerr << "Error parsing arguments: " << e.what() << endl;
         return 1;
     }
-    
-    AVLTree avlTree;
-    
-    // Attempt to deserialize (load) the existing file
-    bool deserialize_success = avlTree.deserialize(datFilename);
-    
-    if (!deserialize_success) {
-        // If file doesn't exist, treat it as a new file and insert the student
-        cout << "File not found or failed to load. Initializing new AVL tree for student ID " << studentId << "." << endl;
-    } 
 
-    // Update the attendance for the student ID. 
-    // This handles both inserting a new student and updating an existing one.
-    bool studentFoundBeforeUpdate = avlTree.updateAttendance(studentId, newAttendance);
-    
-    if (studentFoundBeforeUpdate) {
-        cout << "Updated attendance for student ID " << studentId << " to " << newAttendance << endl;
-    } else {
-        cout << "Inserted new entry for student ID " << studentId << " with attendance " << newAttendance << endl;
-    }
-    
-    // Serialize the updated AVL tree back to the file
-    if (!avlTree.serialize(datFilename)) {
-        cerr << "Failed to serialize the updated AVL tree to " << datFilename << endl;
+    // Held until exit: the generation read below must still be current when
+    // the record is appended, and only one writer may compact at a time.
+    WriterLock lock(datFilename);
+    if (!lock.held()) {
+        cerr << "Failed to lock " << datFilename << " for writing" << endl;
         return 1;
     }
-    
-    return 0;
-}
 
+    // Flat snapshots take the cheap path: append one record to the update log
+    // and only rewrite the snapshot once the log has grown past its threshold.
+    AVLView view;
+    if (AVLView::isFlat(datFilename) && view.open(datFilename)) {
+        bool studentFoundBeforeUpdate = view.contains(studentId);
+        if (!UpdateLog::append(datFilename, studentId, newAttendance, view.generation())) {
+            cerr << "Failed to append to the update log " << UpdateLog::pathFor(datFilename) << endl;
+            return 1;
+        }
+
+        if (studentFoundBeforeUpdate) {
+            cout << "Updated attendance for student ID " << studentId << " to " << newAttendance << endl;
+        } else {
+            cout << "Inserted new entry for student ID " << studentId << " with attendance " << newAttendance << endl;
+        }
+
+        if (UpdateLog::recordCount(datFilename) >= UpdateLog::compactionThreshold()) {
+            if (!(useBuckets ? compactLog<BucketIndex>(datFilename) : compactLog<AVLTree>(datFilename))) {
+                cerr << "Failed to compact the update log into " << datFilename << endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    return useBuckets ? rewriteWithUpdate<BucketIndex>(datFilename, newAttendance, studentId)
+                      : rewriteWithUpdate<AVLTree>(datFilename, newAttendance, studentId);
+}
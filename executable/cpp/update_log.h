@@ -0,0 +1,174 @@
+#pragma once
+#include "metrics.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Append-only update log kept next to a serialized AVL tree ("<file>.wal").
+// Each attendance change appends one fixed-size record instead of rewriting
+// the whole snapshot; loaders replay the log over the snapshot.
+//
+// The log starts with a header naming the snapshot generation it applies to.
+// Compaction writes a snapshot with the next generation before removing the
+// log, so a log left behind by a crash no longer matches and is ignored.
+
+struct UpdateLogHeader {
+    char magic[4];  // "WAL1"
+    uint32_t generation;
+};
+
+struct UpdateRecord {
+    int32_t studentId;
+    int32_t attendance;
+    uint32_t checksum;  // detects a torn record at the tail after a crash
+};
+
+class UpdateLog {
+private:
+    static uint32_t checksumOf(int32_t studentId, int32_t attendance) {
+        uint32_t hash = 2166136261u;  // FNV-1a over both fields
+        for (uint32_t value : {static_cast<uint32_t>(studentId), static_cast<uint32_t>(attendance)}) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                hash = (hash ^ ((value >> shift) & 0xFF)) * 16777619u;
+            }
+        }
+        return hash;
+    }
+
+public:
+    static string pathFor(const string& datFilename) {
+        return datFilename + ".wal";
+    }
+
+    static UpdateRecord makeRecord(int studentId, int attendance) {
+        return {studentId, attendance, checksumOf(studentId, attendance)};
+    }
+
+    // Records compacted into the snapshot once the log reaches this size;
+    // override with ATTENDANCE_WAL_MAX_RECORDS.
+    static size_t compactionThreshold() {
+        const char* configured = getenv("ATTENDANCE_WAL_MAX_RECORDS");
+        if (configured) {
+            long value = strtol(configured, nullptr, 10);
+            if (value > 0) return static_cast<size_t>(value);
+        }
+        return 4096;
+    }
+
+    // Appends records with a single write and syncs them to disk. A missing
+    // log, or one left over from an older generation, is started afresh.
+    // firstRecord, if given, receives the position of the first new record
+    // (see truncate).
+    static bool append(const string& datFilename, const vector<UpdateRecord>& records, uint32_t generation,
+                       size_t* firstRecord = nullptr) {
+        if (records.empty()) return true;
+        ScopedTimer timer(Phase::LogAppend);
+        int fd = ::open(pathFor(datFilename).c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+
+        UpdateLogHeader header;
+        bool current = ::pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+                       memcmp(header.magic, "WAL1", 4) == 0 && header.generation == generation;
+        if (!current) {
+            header = {{'W', 'A', 'L', '1'}, generation};
+            if (ftruncate(fd, 0) != 0 ||
+                ::pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+                ::close(fd);
+                return false;
+            }
+        }
+
+        // Drop any torn tail so new records stay aligned.
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        off_t offset = sizeof(header) +
+            (info.st_size - static_cast<off_t>(sizeof(header))) / sizeof(UpdateRecord) * sizeof(UpdateRecord);
+        if (firstRecord) *firstRecord = (offset - sizeof(header)) / sizeof(UpdateRecord);
+
+        const char* bytes = reinterpret_cast<const char*>(records.data());
+        size_t length = records.size() * sizeof(UpdateRecord), written = 0;
+        while (written < length) {
+            ssize_t n = ::pwrite(fd, bytes + written, length - written, offset + written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ::close(fd);
+                return false;
+            }
+            written += n;
+        }
+        bool synced = fdatasync(fd) == 0;
+        ::close(fd);
+        Metrics::add(Counter::BytesWritten, length);
+        return synced;
+    }
+
+    static bool append(const string& datFilename, int studentId, int attendance, uint32_t generation) {
+        return append(datFilename, vector<UpdateRecord>{makeRecord(studentId, attendance)}, generation);
+    }
+
+    // Valid records in append order for the given snapshot generation; reading
+    // stops at the first torn or corrupt record.
+    static vector<UpdateRecord> read(const string& datFilename, uint32_t generation) {
+        vector<UpdateRecord> records;
+        int fd = ::open(pathFor(datFilename).c_str(), O_RDONLY);
+        if (fd < 0) return records;
+
+        UpdateLogHeader header;
+        struct stat info;
+        bool current = ::pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+                       memcmp(header.magic, "WAL1", 4) == 0 && header.generation == generation;
+        if (current && fstat(fd, &info) == 0) {
+            records.resize((info.st_size - sizeof(header)) / sizeof(UpdateRecord));
+            size_t length = records.size() * sizeof(UpdateRecord), done = 0;
+            char* bytes = reinterpret_cast<char*>(records.data());
+            while (done < length) {
+                ssize_t n = ::pread(fd, bytes + done, length - done, sizeof(header) + done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                done += n;
+            }
+            records.resize(done / sizeof(UpdateRecord));
+            Metrics::add(Counter::BytesRead, sizeof(header) + done);
+        }
+        ::close(fd);
+
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (records[i].checksum != checksumOf(records[i].studentId, records[i].attendance)) {
+                records.resize(i);
+                break;
+            }
+        }
+        return records;
+    }
+
+    // Upper bound on the records in the log (ignores generation and checksums).
+    static size_t recordCount(const string& datFilename) {
+        struct stat info;
+        if (stat(pathFor(datFilename).c_str(), &info) != 0 ||
+            info.st_size < static_cast<off_t>(sizeof(UpdateLogHeader))) return 0;
+        return (info.st_size - sizeof(UpdateLogHeader)) / sizeof(UpdateRecord);
+    }
+
+    // Drops every record from position `records` on, undoing an append whose
+    // counterpart in another log failed. The caller still holds the writer
+    // lock it appended under.
+    static bool truncate(const string& datFilename, size_t records) {
+        return ::truncate(pathFor(datFilename).c_str(), sizeof(UpdateLogHeader) + records * sizeof(UpdateRecord)) == 0;
+    }
+
+    // Called only after the snapshot that folds in the log has been renamed into place.
+    static bool remove(const string& datFilename) {
+        return unlink(pathFor(datFilename).c_str()) == 0 || errno == ENOENT;
+    }
+};
@@ -0,0 +1,53 @@
+#include "avl.h"
+#include "trie.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Upgrades legacy recursive .dat files and older flat versions to the
+// current flat, mmap-able format in place (version 3 stores compressed IDs).
+// Files that are already current are left untouched.
+// Example: ./upgrade_dat avl ../serialized/maths.dat ../serialized/physics.dat
+//          ./upgrade_dat trie ../serialized/name.dat
+int main(int argc, char* argv[]) {
+    MetricsReport metrics("upgrade_dat", argc, argv);
+    if (argc < 3 || (string(argv[1]) != "avl" && string(argv[1]) != "trie")) {
+        cerr << "Usage: " << argv[0] << " <avl|trie> <dat_file_name>..." << endl;
+        return 1;
+    }
+
+    const bool isTrie = string(argv[1]) == "trie";
+    int failures = 0;
+
+    for (int i = 2; i < argc; ++i) {
+        const string datFilename = argv[i];
+        bool current = isTrie ? TrieView::readVersion(datFilename) == FLAT_TRIE_VERSION
+                              : AVLView::readVersion(datFilename) == FLAT_AVL_VERSION;
+        if (current) {
+            cout << datFilename << ": already in flat format v"
+                 << (isTrie ? FLAT_TRIE_VERSION : FLAT_AVL_VERSION) << endl;
+            continue;
+        }
+
+        bool upgraded;
+        if (isTrie) {
+            Trie trie;
+            upgraded = trie.deserialize(datFilename) && trie.serialize(datFilename);
+        } else {
+            WriterLock lock(datFilename);
+            AVLTree avlTree;
+            upgraded = lock.held() && avlTree.deserialize(datFilename) && avlTree.serialize(datFilename);
+        }
+
+        if (upgraded) {
+            cout << datFilename << ": upgraded to flat format v"
+                 << (isTrie ? FLAT_TRIE_VERSION : FLAT_AVL_VERSION) << endl;
+        } else {
+            cerr << datFilename << ": failed to upgrade" << endl;
+            ++failures;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Single-writer publication of a value that readers query concurrently.
+// Two copies are kept (the "left-right" scheme). Readers take the published
+// copy as a shared_ptr and keep a consistent version for as long as they
+// hold it. They never wait for the writer; the writer waits for them for
+// at most PATIENCE yields, however long a read runs.
+//
+// write() applies a change to the standby copy and publishes it with one
+// atomic swap. The copy it replaced becomes the new standby, one change
+// behind; the change is kept and replayed there at the start of the next
+// write, once no reader holds that copy (the shared_ptr count says when).
+// If readers still hold it after PATIENCE yields, the writer leaves it to
+// them, the last one frees it, and the writer copies the published version
+// instead. An update therefore costs two applications of the change, and a
+// full copy only when a read that started before the previous update is
+// still running.
+//
+// Writes are not synchronized with each other: callers serialize them (the
+// engine holds its writer mutex around the logging and the write()).
+template <typename T>
+class Versioned {
+private:
+    shared_ptr<T> published;
+    shared_ptr<T> standby;
+    vector<function<void(T&)>> pending;  // published changes standby still lacks
+
+    // Yields a CPU slice this many times for the readers of standby to
+    // finish before the writer gives up on it and copies the published
+    // version instead.
+    static constexpr int PATIENCE = 16;
+
+    // Makes standby equal to the published version and owned by the writer alone.
+    void catchUp() {
+        for (int yields = 0; yields < PATIENCE && standby.use_count() > 1; ++yields) this_thread::yield();
+        if (standby.use_count() > 1) {
+            standby = make_shared<T>(*published);
+            pending.clear();
+            return;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        for (auto& change : pending) change(*standby);
+        pending.clear();
+    }
+
+public:
+    explicit Versioned(const T& initial = T())
+        : published(make_shared<T>(initial)), standby(make_shared<T>(initial)) {}
+
+    // The current version; stays valid and unchanged while held.
+    shared_ptr<const T> read() const {
+        return atomic_load(&published);
+    }
+
+    // change(T&) must be deterministic, and must capture what it uses by
+    // value: it is kept after write() returns and replayed on the other copy.
+    // Returns the result of the first run, which is the one readers see.
+    template <typename Change>
+    auto write(Change change) -> decltype(change(declval<T&>())) {
+        using Result = decltype(change(declval<T&>()));
+        catchUp();
+        if constexpr (is_void_v<Result>) {
+            change(*standby);
+            standby = atomic_exchange(&published, standby);
+            pending.emplace_back(move(change));
+        } else {
+            Result result = change(*standby);
+            standby = atomic_exchange(&published, standby);
+            pending.emplace_back(move(change));
+            return result;
+        }
+    }
+
+    // Replaces both copies, e.g. after reloading from disk.
+    void reset(const T& value) {
+        shared_ptr<T> replacement = make_shared<T>(value);
+        atomic_store(&published, replacement);
+        standby = make_shared<T>(value);
+        pending.clear();
+    }
+
+    // The unpublished copy, brought up to the published version first. For
+    // writer-side work such as serializing that must not race readers.
+    T& writerCopy() {
+        catchUp();
+        return *standby;
+    }
+};
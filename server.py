@@ -4,7 +4,11 @@ import numpy as np
 import cv2
 import dlib
 import os
+import socket
 import subprocess
+import time
+import atexit
+import base64
 from flask_cors import CORS
 
 # --- CRITICAL PATH SETTINGS ---
@@ -13,6 +17,10 @@ PROJECT_ROOT = os.path.dirname(os.path.abspath(__file__))
 EXECUTABLE_DIR = os.path.join(PROJECT_ROOT, 'executable', 'cpp')
 SERIALIZED_DIR = os.path.join(PROJECT_ROOT, 'executable', 'serialized')
 DATA_DIR = os.path.join(PROJECT_ROOT, 'executable', 'data')
+# Unix socket of the resident C++ attendance engine
+ENGINE_SOCKET = os.environ.get('ATTENDANCE_ENGINE_SOCKET', '/tmp/attendance_engine.sock')
+# Closest fuzzy matches returned when /search_students is not paged
+FUZZY_LIMIT = 20
 
 # --- LOAD DATAFRAMES ---
 try:
@@ -29,47 +37,73 @@ except FileNotFoundError as e:
 # Ensure folders exist
 os.makedirs(SERIALIZED_DIR, exist_ok=True)
 
-# --- CREATE AVL TREE FOR EACH SUBJECT ---
-def create_avl_tree_for_subject(subject):
-    # Data is loaded from CSV
-    subject_data = attendance_df[['student_id', subject]].dropna()
-    serialized_filename = os.path.join(SERIALIZED_DIR, f"{subject}.dat")
-
-    # Command: Call executable directly inside its directory
-    command = ['./create_avl', serialized_filename]
-    input_lines = [f"{row[subject]} {row['student_id']}\n" for _, row in subject_data.iterrows()]
-    input_str = ''.join(input_lines)
-
-    try:
-        # Run executable from its directory (executable/cpp)
-        subprocess.run(command, input=input_str.encode(), cwd=EXECUTABLE_DIR, check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-        print(f"[✓] AVL tree for '{subject}' saved as '{serialized_filename}'")
-    except subprocess.CalledProcessError as e:
-        print(f"[✗] Error creating AVL for '{subject}': {e.stderr.decode()}")
-    except Exception as e:
-        print(f"[✗] Unexpected error: {str(e)}")
-
-# --- INITIALIZE TREES AND TRIE ---
+# --- BUILD THE AVL TREES AND THE TRIE ---
+# One build_all run reads attendance.csv and students.csv once and writes
+# every subject's AVL file plus the name Trie (executable/cpp/build_all.cpp)
 subjects = ['maths', 'english', 'chemistry', 'physics', 'datastructure', 'total_attendance']
 print("\n--- INITIALIZING DATA STRUCTURES ---")
 
-for subject in subjects:
-    create_avl_tree_for_subject(subject)
-
 try:
-    # Run create_trie executable from its directory (executable/cpp)
+    # Run build_all from its directory (executable/cpp)
     result = subprocess.run(
-        ['./create_trie'],
+        ['./build_all', '--data', DATA_DIR, '--serialized', SERIALIZED_DIR],
         cwd=EXECUTABLE_DIR,
         check=True,
         stdout=subprocess.PIPE,
         stderr=subprocess.PIPE
     )
-    print("[✓] Trie creation completed successfully.")
+    for line in result.stdout.decode().splitlines():
+        print(f"[✓] {line}")
 except subprocess.CalledProcessError as e:
-    print(f"[✗] Error running create_trie: {e.stderr.decode()}")
+    print(f"[✗] Error running build_all: {e.stderr.decode()}")
 except Exception as e:
-    print(f"[✗] Unexpected error running create_trie: {str(e)}")
+    print(f"[✗] Unexpected error running build_all: {str(e)}")
+
+# --- ATTENDANCE ENGINE CLIENT ---
+class EngineError(Exception):
+    pass
+
+def engine_request(line):
+    # One request per connection: send a line, read "OK <n>" plus n lines (or "ERR <msg>")
+    line = line.replace('\r', ' ').replace('\n', ' ')
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            sock.connect(ENGINE_SOCKET)
+            sock.sendall((line + '\n').encode())
+            reader = sock.makefile('r', encoding='utf-8')
+            header = reader.readline().rstrip('\n')
+            if not header.startswith('OK '):
+                raise EngineError(header[4:] if header.startswith('ERR ') else 'Malformed engine response')
+            count = int(header.split()[1])
+            return [reader.readline().rstrip('\n') for _ in range(count)]
+    except OSError as e:
+        raise EngineError(f"Attendance engine unavailable: {e}")
+
+def encode_embedding(face_vector):
+    # The engine takes embeddings as base64 of little-endian float32 values
+    return base64.b64encode(np.asarray(face_vector, dtype='<f4').tobytes()).decode()
+
+def start_engine():
+    # Reuse a running engine (e.g. across Flask reloads) but make it pick up the rebuilt files
+    try:
+        engine_request('RELOAD')
+        print("[✓] Attendance engine reloaded.")
+        return
+    except EngineError:
+        pass
+
+    process = subprocess.Popen(['./attendance_engine', ENGINE_SOCKET], cwd=EXECUTABLE_DIR)
+    atexit.register(process.terminate)
+    for _ in range(50):
+        try:
+            engine_request('PING')
+            print(f"[✓] Attendance engine listening on {ENGINE_SOCKET}")
+            return
+        except EngineError:
+            time.sleep(0.1)
+    print("[✗] Attendance engine did not start.")
+
+start_engine()
 
 print("--- INITIALIZATION COMPLETE ---\n")
 
@@ -109,8 +143,9 @@ def add_student():
         students_df = pd.concat([students_df, new_student_row], ignore_index=True)
         students_df.to_csv(os.path.join(DATA_DIR, 'students.csv'), index=False)
 
-        # Insert into Trie (C++)
-        subprocess.run(['./insert_trie', name, str(student_id)], cwd=EXECUTABLE_DIR, check=True)
+        # Insert into Trie and enroll the face (C++ engine)
+        engine_request(f"INSERT {student_id} {name}")
+        engine_request(f"ENROLL {student_id} {encode_embedding(face_vector)}")
 
         # Initialize attendance for the student
         new_attendance_row = pd.DataFrame({
@@ -121,16 +156,14 @@ def add_student():
         attendance_df = pd.concat([attendance_df, new_attendance_row], ignore_index=True)
         attendance_df.to_csv(os.path.join(DATA_DIR, 'attendance.csv'), index=False)
 
-        # Update all AVL trees
+        # Add the student to every subject column (total_attendance follows the subjects)
         for subject in subjects:
-            subprocess.run(
-                ['./update_avl', os.path.join(SERIALIZED_DIR, f"{subject}.dat"), "0", str(student_id)],
-                cwd=EXECUTABLE_DIR, check=True
-            )
+            if subject != 'total_attendance':
+                engine_request(f"UPDATE {subject} 0 {student_id}")
 
         return jsonify({'status': 'success', 'message': 'Student added successfully'})
-    except subprocess.CalledProcessError as e:
-        print(f"[ERROR] Add student failed: {e.stderr.decode()}")
+    except EngineError as e:
+        print(f"[ERROR] Add student failed: {e}")
         return jsonify({'status': 'error', 'message': 'Failed to insert in Trie'}), 500
     except Exception as e:
         print(f"[ERROR] Add student failed: {str(e)}")
@@ -144,19 +177,9 @@ def verify():
         
         # Capture facial vector (uses placeholder)
         face_vector = capture_face_vector() 
-        face_vector_str = [str(x) for x in face_vector]
         
-        # Call C++ distance executable
-        command = ['./distance'] + face_vector_str
-        result = subprocess.run(
-            command,
-            cwd=EXECUTABLE_DIR,
-            stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
-            check=True,
-            text=True
-        )
-        student_id = int(result.stdout.strip())
+        # Nearest enrolled face from the engine's resident matcher (-1 if none is close enough)
+        student_id = int(engine_request(f"MATCH {encode_embedding(face_vector)}")[0])
 
         if student_id != -1:
             # 1. Update attendance in CSV
@@ -168,31 +191,64 @@ def verify():
                 attendance_df.loc[idx, 'total_attendance'] = attendance_df.loc[idx, 'total_attendance'] + 1
                 attendance_df.to_csv(os.path.join(DATA_DIR, 'attendance.csv'), index=False)
 
-                # Retrieve new attendance values for AVL update
+                # Retrieve the new attendance value for the subject column
                 attendance_val = int(attendance_df.loc[idx, subject].iloc[0])
-                total_val = int(attendance_df.loc[idx, 'total_attendance'].iloc[0])
-
-                # 2. Call C++ update_avl (DSA: Update AVL trees)
-                subprocess.run(
-                    ['./update_avl', os.path.join(SERIALIZED_DIR, f"{subject}.dat"), str(attendance_val), student_id_str],
-                    cwd=EXECUTABLE_DIR, check=True
-                )
-                subprocess.run(
-                    ['./update_avl', os.path.join(SERIALIZED_DIR, "total_attendance.dat"), str(total_val), student_id_str],
-                    cwd=EXECUTABLE_DIR, check=True
-                )
+
+                # 2. Update the resident store; the engine moves total_attendance by the same delta
+                engine_request(f"UPDATE {subject} {attendance_val} {student_id_str}")
                 
             return jsonify({'status': 'success', 'message': f'Attendance marked for ID {student_id}'})
         else:
             return jsonify({'status': 'error', 'message': 'No student found'}), 404
             
-    except subprocess.CalledProcessError as e:
-        print(f"[ERROR] Verification failed (C++ distance or update failed): {e.stderr.decode()}")
+    except EngineError as e:
+        print(f"[ERROR] Verification failed (engine request failed): {e}")
         return jsonify({'status': 'error', 'message': 'Verification failed due to backend error'}), 500
     except Exception as e:
         print(f"[ERROR] Verification failed: {str(e)}")
         return jsonify({'status': 'error', 'message': str(e)}), 500
 
+@app.route('/verify_batch', methods=['POST'])
+def verify_batch():
+    # Marks attendance for every face in one request, e.g. a classroom snapshot.
+    # Body: {"subject": "...", "embeddings": [[...], ...]}
+    try:
+        payload = request.get_json(silent=True) or {}
+        subject = payload.get('subject')
+        embeddings = payload.get('embeddings') or []
+        if subject not in attendance_df.columns or subject in ('student_id', 'total_attendance') or not embeddings:
+            return jsonify({'status': 'error', 'message': 'subject and a non-empty embeddings list are required'}), 400
+
+        # All faces are scored against the gallery in one engine call, in parallel
+        packed = base64.b64encode(np.asarray(embeddings, dtype='<f4').tobytes()).decode()
+        faces = []
+        for line in engine_request(f"MATCHBATCH {packed}"):
+            student_id, distance = line.split()
+            faces.append({'student_id': int(student_id), 'distance': float(distance)})
+
+        # A student seen twice in the same snapshot is marked once
+        marked = list(dict.fromkeys(f['student_id'] for f in faces if f['student_id'] != -1))
+        ids = attendance_df['student_id'].astype(str)
+        idx = attendance_df.index[ids.isin([str(i) for i in marked])]
+        if not idx.empty:
+            attendance_df.loc[idx, subject] = attendance_df.loc[idx, subject] + 1
+            attendance_df.loc[idx, 'total_attendance'] = attendance_df.loc[idx, 'total_attendance'] + 1
+            attendance_df.to_csv(os.path.join(DATA_DIR, 'attendance.csv'), index=False)
+
+            # One grouped update (a single log append per tree) instead of one per face;
+            # the engine moves total_attendance along with the subject
+            subject_pairs = ' '.join(f"{int(a)}:{s}" for a, s in zip(attendance_df.loc[idx, subject], ids[idx]))
+            engine_request(f"UPDATEBATCH {subject} {subject_pairs}")
+
+        return jsonify({'status': 'success', 'faces': faces, 'marked': [int(s) for s in ids[idx]]})
+
+    except EngineError as e:
+        print(f"[ERROR] Batch verification failed (engine request failed): {e}")
+        return jsonify({'status': 'error', 'message': 'Verification failed due to backend error'}), 500
+    except Exception as e:
+        print(f"[ERROR] Batch verification failed: {str(e)}")
+        return jsonify({'status': 'error', 'message': str(e)}), 500
+
 @app.route('/get_attendance', methods=['GET'])
 def get_attendance():
     data = attendance_df.to_dict(orient='records')
@@ -202,23 +258,56 @@ def get_attendance():
 def search_students():
     try:
         query = request.form.get('query', '')
-        if not query:
+        if not query.strip():
             return jsonify({'status': 'error', 'message': 'Query is required'}), 400
 
-        # Call C++ search_trie executable
-        result = subprocess.run(
-            ['./search_trie', query],
-            cwd=EXECUTABLE_DIR,
-            check=True,
-            stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
-            text=True
-        )
-        ids = [str(x) for x in result.stdout.strip().split('\n') if x.isdigit()]
-        matches = attendance_df[attendance_df['student_id'].astype(str).isin(ids)].to_dict(orient='records')
-        return jsonify({'status': 'success', 'data': matches})
-    except subprocess.CalledProcessError as e:
-        print(f"[ERROR] Trie search failed: {e.stderr.decode()}")
+        # Optional paging for type-ahead: 'limit' caps the page, 'cursor' resumes
+        # where the previous page stopped (next_cursor is null on the last page)
+        limit = request.form.get('limit', '')
+        cursor = request.form.get('cursor', '') or '-'
+        if limit and (not limit.isdigit() or int(limit) <= 0):
+            return jsonify({'status': 'error', 'message': 'limit must be a positive integer'}), 400
+        # Typo-tolerant search: 'fuzzy=1' asks for it, 'max_distance' overrides
+        # the budget picked from the query length
+        fuzzy = request.form.get('fuzzy', '') in ('1', 'true')
+        max_distance = request.form.get('max_distance', '') or '-'
+        if max_distance != '-' and not max_distance.isdigit():
+            return jsonify({'status': 'error', 'message': 'max_distance must be a non-negative integer'}), 400
+
+        if not fuzzy:
+            # Paged type-ahead walks the full-name Trie in name order; an unpaged
+            # search matches each word of the query against any part of the name
+            # ("Aa Sh" finds "Aarav Sharma"), answered from the token index
+            next_cursor = None
+            if limit:
+                lines = engine_request(f"SEARCHPAGE {limit} {cursor} {query}")
+                next_cursor = None if lines[0] == '-' else lines[0]
+                ids = [x for x in lines[1:] if x.isdigit()]
+            else:
+                ids = [x for x in engine_request(f"SEARCHTOKENS {query}") if x.isdigit()]
+            # A first search that finds nothing falls back to the fuzzy search below
+            fuzzy = not ids and cursor == '-'
+            if not fuzzy:
+                matches = attendance_df[attendance_df['student_id'].astype(str).isin(ids)].to_dict(orient='records')
+                response = {'status': 'success', 'data': matches}
+                if limit:
+                    response['next_cursor'] = next_cursor
+                return jsonify(response)
+
+        # Fuzzy results come closest first; rows keep that order and carry their distance
+        lines = engine_request(f"FUZZY {limit or FUZZY_LIMIT} {max_distance} {query}")
+        ranked = [line.split() for line in lines]
+        distances = {student_id: int(distance) for student_id, distance in ranked}
+        rows = attendance_df[attendance_df['student_id'].astype(str).isin(list(distances))].to_dict(orient='records')
+        by_id = {str(row['student_id']): row for row in rows}
+        matches = [dict(by_id[student_id], distance=distances[student_id])
+                   for student_id, _ in ranked if student_id in by_id]
+        response = {'status': 'success', 'data': matches, 'fuzzy': True}
+        if limit:
+            response['next_cursor'] = None
+        return jsonify(response)
+    except EngineError as e:
+        print(f"[ERROR] Trie search failed: {e}")
         return jsonify({'status': 'error', 'message': 'Trie search failed'}), 500
     except Exception as e:
         print(f"[ERROR] General search error: {str(e)}")
@@ -230,30 +319,56 @@ def threshold_attendance():
         subject = request.form.get('subject', '')
         threshold = request.form.get('threshold', '')
         direction = request.form.get('direction', '')
-        if not all([subject, threshold, direction]):
+        # Optional upper bound turns the query into a band: threshold <= attendance <= upper
+        upper = request.form.get('upper', '')
+        if not subject or not threshold or not (direction or upper):
             return jsonify({'status': 'error', 'message': 'All fields required'}), 400
 
-        dat_file = os.path.join(SERIALIZED_DIR, f"{subject}.dat")
-        result = subprocess.run(
-            ['./threshold', dat_file, str(threshold), direction],
-            cwd=EXECUTABLE_DIR,
-            check=True,
-            stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
-            text=True
-        )
-        # Output is student IDs separated by newlines
-        ids = [str(x) for x in result.stdout.strip().split('\n') if x.isdigit()]
+        # Threshold (or band) search on the resident AVL tree
+        if upper:
+            engine_line = f"RANGE {subject} {threshold} {upper}"
+        else:
+            engine_line = f"THRESHOLD {subject} {threshold} {direction}"
+        ids = [x for x in engine_request(engine_line) if x.isdigit()]
 
         matches = attendance_df[attendance_df['student_id'].astype(str).isin(ids)].to_dict(orient='records')
         return jsonify({'status': 'success', 'data': matches})
         
-    except subprocess.CalledProcessError as e:
-        print(f"[ERROR] Threshold search failed: {e.stderr.decode()}")
+    except EngineError as e:
+        print(f"[ERROR] Threshold search failed: {e}")
         return jsonify({'status': 'error', 'message': 'Threshold search failed'}), 500
     except Exception as e:
         print(f"[ERROR] General threshold error: {str(e)}")
         return jsonify({'status': 'error', 'message': str(e)}), 500
 
+@app.route('/query_attendance', methods=['POST'])
+def query_attendance():
+    # Multi-subject conditions answered by the engine in one request,
+    # e.g. {"conditions": ["maths<60", "physics<60"]} (all must hold)
+    try:
+        payload = request.get_json(silent=True) or {}
+        conditions = payload.get('conditions') or []
+        if not conditions or not all(isinstance(c, str) and c and ' ' not in c for c in conditions):
+            return jsonify({'status': 'error', 'message': 'conditions must be a non-empty list like "maths<60"'}), 400
+
+        ids = [x for x in engine_request(f"WHERE {' '.join(conditions)}") if x.isdigit()]
+        matches = attendance_df[attendance_df['student_id'].astype(str).isin(ids)].to_dict(orient='records')
+        return jsonify({'status': 'success', 'data': matches})
+
+    except EngineError as e:
+        print(f"[ERROR] Attendance query failed: {e}")
+        return jsonify({'status': 'error', 'message': str(e)}), 400
+    except Exception as e:
+        print(f"[ERROR] General query error: {str(e)}")
+        return jsonify({'status': 'error', 'message': str(e)}), 500
+
+@app.route('/metrics', methods=['GET'])
+def metrics():
+    # Prometheus scrape endpoint; the engine must run with ATTENDANCE_METRICS=1 or --metrics
+    try:
+        return '\n'.join(engine_request('METRICS')) + '\n', 200, {'Content-Type': 'text/plain; version=0.0.4'}
+    except EngineError as e:
+        return str(e) + '\n', 503, {'Content-Type': 'text/plain'}
+
 if __name__ == '__main__':
     app.run(debug=True)